@@ -0,0 +1,1130 @@
+// Micro-benchmarks for the FinalCompiler front end.
+//
+// Build: g++ -std=c++20 -O2 Benchmarks.cpp -o Benchmarks -lpthread
+// Run:   ./Benchmarks            (all benchmarks)
+//        ./Benchmarks keywords   (only the named ones)
+
+#define FINAL_COMPILER_NO_MAIN
+#include "FinalCompiler.cpp"
+
+#include <chrono>
+#include <functional>
+
+// Keeps the optimizer from discarding the measured work.
+volatile size_t benchSink = 0;
+
+// Best wall-clock time in seconds over a few runs of fn.
+double bestOf(int runs, const function<void()> &fn)
+{
+    double best = 1e300;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+// Discards everything written to it; used to silence the Parser's listings.
+struct NullBuffer : streambuf
+{
+    int overflow(int c) override { return c; }
+};
+
+void report(const string &label, double seconds, double units, const string &unitName)
+{
+    cout << "  " << label << ": " << seconds * 1000 << " ms, "
+         << units / seconds / 1e6 << " M" << unitName << "/s" << endl;
+}
+
+// ---------------------------------------------------------------------------
+// keywords: perfect-hash classifyWord() against the original if/else chain,
+// and the Urdu dialect's table on the same words.
+
+TokenTypeValue classifyWordChain(string_view word)
+{
+    string copy(word); // the original chain compared std::string copies
+    if (copy == "int")
+        return T_INT;
+    else if (copy == "float")
+        return T_FLOAT;
+    else if (copy == "bool")
+        return T_BOOL;
+    else if (copy == "true" || copy == "false")
+        return T_BOOL_LITERAL;
+    else if (copy == "if")
+        return T_IF;
+    else if (copy == "string")
+        return T_STRING;
+    else if (copy == "else")
+        return T_ELSE;
+    else if (copy == "for")
+        return T_FOR;
+    else if (copy == "while")
+        return T_WHILE;
+    else if (copy == "do")
+        return T_DO;
+    else if (copy == "return")
+        return T_RETURN;
+    return T_ID;
+}
+
+void benchKeywords()
+{
+    const char *names[] = {"counter", "i", "value", "total", "while", "int",
+                           "x", "returnValue", "flag", "float", "index", "do"};
+    const size_t wordCount = 2000000;
+    string source;
+    vector<string_view> words;
+    source.reserve(wordCount * 8);
+    for (size_t i = 0; i < wordCount; i++)
+    {
+        source += names[(i * 7) % 12];
+        source += ' ';
+    }
+    for (size_t start = 0; start < source.size();)
+    {
+        size_t end = source.find(' ', start);
+        words.push_back(string_view(source).substr(start, end - start));
+        start = end + 1;
+    }
+
+    cout << "keywords: " << words.size() << " identifier-heavy words" << endl;
+    double chain = bestOf(5, [&]()
+    {
+        size_t sum = 0;
+        for (string_view word : words)
+            sum += classifyWordChain(word);
+        benchSink = sum;
+    });
+    double hashed = bestOf(5, [&]()
+    {
+        size_t sum = 0;
+        for (string_view word : words)
+            sum += classifyWord(word);
+        benchSink = sum;
+    });
+    double urdu = bestOf(5, [&]()
+    {
+        size_t sum = 0;
+        for (string_view word : words)
+            sum += classifyWord<UrduDialect>(word);
+        benchSink = sum;
+    });
+    report("if/else chain", chain, words.size(), "words");
+    report("perfect hash ", hashed, words.size(), "words");
+    report("perfect hash (urdu)", urdu, words.size(), "words");
+
+    double lex = bestOf(5, [&]()
+    {
+        StringPool pool;
+        Lexer lexer(source, pool);
+        benchSink = lexer.tokenize().size();
+    });
+    report("Lexer::tokenize", lex, source.size(), "B");
+}
+
+// ---------------------------------------------------------------------------
+// scan: Lexer::tokenize on comment banners and long string constants with
+// each set of scanning kernels.
+
+void benchScan()
+{
+    string source;
+    for (int i = 0; i < 20000; i++)
+    {
+        source += "/****************************************************************\n";
+        source += " * generated section " + to_string(i) + "                                   \n";
+        source += " ****************************************************************/\n";
+        source += "        // line comment describing the next declaration in some detail\n";
+        source += "        string s" + to_string(i) + " = \"";
+        source += string(200, 'x');
+        source += "\";\n\n";
+    }
+
+    vector<const ScanKernels *> kernels = {&SCALAR_SCAN};
+#if defined(__x86_64__)
+    kernels.push_back(&SSE2_SCAN);
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back(&AVX2_SCAN);
+#endif
+
+    cout << "scan: " << source.size() / 1e6 << " MB of comments and strings, active kernels: "
+         << activeScan->name << endl;
+    const ScanKernels *selected = activeScan;
+    size_t expected = 0;
+    for (const ScanKernels *kernel : kernels)
+    {
+        activeScan = kernel;
+        size_t count = 0;
+        double seconds = bestOf(5, [&]()
+        {
+            StringPool pool;
+            Lexer lexer(source, pool);
+            count = lexer.tokenize().size();
+        });
+        if (expected == 0)
+            expected = count;
+        else if (count != expected)
+            cout << "  token count mismatch for " << kernel->name << endl;
+        report(kernel->name, seconds, source.size(), "B");
+    }
+    activeScan = selected;
+}
+
+// ---------------------------------------------------------------------------
+// dfa: the table-driven Lexer against the hand-written switch/if lexer it
+// replaced, on a large mixed corpus.
+
+// The hand-written lexer as it was before the DFA, kept for comparison.
+class ReferenceLexer
+{
+private:
+    string_view src;
+    size_t pos;
+
+    Token makeToken(TokenTypeValue type, size_t start, size_t length)
+    {
+        return Token{type, NO_SYMBOL, src.substr(start, length)};
+    }
+
+    const char *end() const
+    {
+        return src.data() + src.size();
+    }
+
+public:
+    ReferenceLexer(string_view src)
+    {
+        this->src = src;
+        this->pos = 0;
+    }
+
+    vector<Token> tokenize()
+    {
+        vector<Token> tokens;
+        while (pos < src.size())
+        {
+            char current = src[pos];
+            if (current == '/' && pos + 1 < src.size())
+            {
+                if (src[pos + 1] == '/')
+                {
+                    pos = activeScan->findByte(src.data() + pos, end(), '\n') - src.data();
+                    pos++;
+                    continue;
+                }
+                else if (src[pos + 1] == '*')
+                {
+                    const char *close = activeScan->findCommentEnd(src.data() + pos + 2, end());
+                    pos = close == end() ? src.size() : close - src.data() + 2;
+                    continue;
+                }
+            }
+
+            if (isspace(static_cast<unsigned char>(current)))
+            {
+                pos = activeScan->skipSpace(src.data() + pos, end()) - src.data();
+                continue;
+            }
+            if (isdigit(current))
+            {
+                // Only the token kind is compared against the DFA; values
+                // are not decoded here
+                string_view number = consumeNumber();
+                TokenTypeValue type = number.find('.') == string_view::npos ? T_NUM : T_FLOAT_LITERAL;
+                tokens.push_back(Token{type, NO_SYMBOL, number});
+                continue;
+            }
+            if (isalpha(current))
+            {
+                string_view word = consumeWord();
+                tokens.push_back(Token{classifyWord(word), NO_SYMBOL, word});
+                continue;
+            }
+
+            if (current == '"')
+            {
+                tokens.push_back(Token{T_STRING_LITERAL, NO_SYMBOL, consumeString()});
+                continue;
+            }
+
+            switch (current)
+            {
+            case '=':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(makeToken(T_EQ, pos, 2));
+                    pos++;
+                }
+                else
+                {
+                    tokens.push_back(makeToken(T_ASSIGN, pos, 1));
+                }
+                break;
+            case '!':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {                                               // Lookahead
+                    tokens.push_back(makeToken(T_NEQ, pos, 2));
+                    pos++;                                      // Consume the '='
+                }
+                else
+                {
+                    cerr << "Unexpected character '!' at line " << LineIndex(src).locate(pos).line << "\n";
+                    exit(1);
+                }
+                break;
+            case '+':
+                tokens.push_back(makeToken(T_PLUS, pos, 1));
+                break;
+            case '-':
+                tokens.push_back(makeToken(T_MINUS, pos, 1));
+                break;
+            case '*':
+                tokens.push_back(makeToken(T_MUL, pos, 1));
+                break;
+            case '/':
+                tokens.push_back(makeToken(T_DIV, pos, 1));
+                break;
+            case '(':
+                tokens.push_back(makeToken(T_LPAREN, pos, 1));
+                break;
+            case ')':
+                tokens.push_back(makeToken(T_RPAREN, pos, 1));
+                break;
+            case '{':
+                tokens.push_back(makeToken(T_LBRACE, pos, 1));
+                break;
+            case '}':
+                tokens.push_back(makeToken(T_RBRACE, pos, 1));
+                break;
+            case ';':
+                tokens.push_back(makeToken(T_SEMICOLON, pos, 1));
+                break;
+            case '>':
+                // Check if the next character is '=' for the >= operator
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(makeToken(T_GE, pos, 2)); // Greater than or equal to
+                    pos++;                                     // Move past the '=' character
+                }
+                else
+                {
+                    tokens.push_back(makeToken(T_GT, pos, 1)); // Just '>'
+                }
+                break;
+
+            case '<':
+                // Check if the next character is '=' for the <= operator
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(makeToken(T_LE, pos, 2)); // Less than or equal to
+                    pos++;                                     // Move past the '=' character
+                }
+                else
+                {
+                    tokens.push_back(makeToken(T_LT, pos, 1)); // Just '<'
+                }
+                break;
+            default:
+                cout << "Unexpected character: " << current << endl;
+                exit(1);
+            }
+            pos++;
+        }
+        tokens.push_back(makeToken(T_EOF, src.size(), 0));
+        return tokens;
+    }
+
+    string_view consumeNumber()
+    {
+        size_t start = pos;
+        while (pos < src.size() && (isdigit(src[pos]) || src[pos] == '.'))
+            pos++;
+        return src.substr(start, pos - start);
+    }
+
+    string_view consumeWord()
+    {
+        size_t start = pos;
+        while (pos < src.size() && isalnum(src[pos]))
+        {
+            pos++;
+        }
+        return src.substr(start, pos - start);
+    }
+
+    string_view consumeString()
+    {
+        size_t start = pos;
+        if (src[pos] != '"') // Check if it's not a double quote
+        {
+            cerr << "Error: String literal should start with a double quote at line " << LineIndex(src).locate(pos).line << "\n";
+            exit(1); // Exit on error
+        }
+        pos++;
+        pos = activeScan->findByte(src.data() + pos, end(), '"') - src.data();
+        if (pos >= src.size())
+        {
+            cerr << "Error: Unterminated string literal\n";
+            exit(1);
+        }
+        pos++;
+        return src.substr(start, pos - start);
+    }
+};
+
+void benchDfa()
+{
+    string source;
+    for (int i = 0; i < 100000; i++)
+    {
+        string n = to_string(i);
+        source += "int v" + n + " = " + n + ";\n";
+        source += "if (v" + n + " != 3) { v" + n + " = v" + n + " * 2 + 1; }\n";
+        source += "while (v" + n + " <= 100) { v" + n + " = v" + n + " / 2; } // halve\n";
+        source += "float f" + n + " = 3.25; string s" + n + " = \"text\";\n";
+    }
+
+    vector<Token> reference = ReferenceLexer(source).tokenize();
+    StringPool pool;
+    vector<Token> table = Lexer(source, pool).tokenize();
+    bool identical = reference.size() == table.size();
+    for (size_t i = 0; identical && i < reference.size(); i++)
+    {
+        identical = reference[i].type == table[i].type && reference[i].value == table[i].value;
+    }
+
+    cout << "dfa: " << source.size() / 1e6 << " MB, " << table.size() << " tokens, streams "
+         << (identical ? "identical" : "DIFFER") << endl;
+    double handWritten = bestOf(5, [&]()
+    {
+        benchSink = ReferenceLexer(source).tokenize().size();
+    });
+    double dfa = bestOf(5, [&]()
+    {
+        StringPool pool;
+        benchSink = Lexer(source, pool).tokenize().size();
+    });
+    report("hand-written", handWritten, source.size(), "B");
+    report("table DFA   ", dfa, source.size(), "B");
+}
+
+// ---------------------------------------------------------------------------
+// parallel: tokenizeParallel() at several thread counts against the
+// sequential Lexer on a large source with comments and strings.
+
+void benchParallel()
+{
+    string source;
+    for (int i = 0; source.size() < (32u << 20); i++)
+    {
+        string n = to_string(i);
+        source += "/* block " + n + "\n   spans lines */ int v" + n + " = " + n + ";\n";
+        source += "while (v" + n + " <= 100) { v" + n + " = v" + n + " / 2; } // halve\n";
+        source += "string s" + n + " = \"text // not a comment\";\n";
+    }
+
+    StringPool pool;
+    TokenStore sequential = Lexer(source, pool).tokenizeCompact();
+    cout << "parallel: " << source.size() / 1e6 << " MB, " << sequential.size() << " tokens" << endl;
+    double base = bestOf(3, [&]()
+    {
+        StringPool pool;
+        benchSink = Lexer(source, pool).tokenizeCompact().size();
+    });
+    report("sequential", base, source.size(), "B");
+
+    for (size_t threads : {2, 4, 8})
+    {
+        StringPool pool;
+        TokenStore tokens = tokenizeParallel(source, pool, threads);
+        bool identical = tokens.size() == sequential.size();
+        for (size_t i = 0; identical && i < tokens.size(); i++)
+        {
+            identical = tokens.kind(i) == sequential.kind(i) && tokens.offset(i) == sequential.offset(i) &&
+                        tokens.value(i).size() == sequential.value(i).size() &&
+                        tokens.symbolId(i) == sequential.symbolId(i);
+        }
+        double seconds = bestOf(3, [&]()
+        {
+            StringPool pool;
+            benchSink = tokenizeParallel(source, pool, threads).size();
+        });
+        report(to_string(threads) + " threads" + (identical ? "" : " (DIFFERS)"), seconds, source.size(), "B");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// pipeline: end-to-end lex + parse latency with the Parser pulling tokens
+// from the Lexer on one thread, against a lexer thread feeding the parser
+// through a TokenRing.
+
+void *produceTokensThread(void *arg)
+{
+    pair<Lexer *, TokenRing *> *job = (pair<Lexer *, TokenRing *> *)arg;
+    produceTokens(*job->first, *job->second);
+    return NULL;
+}
+
+void benchPipeline()
+{
+    string source;
+    for (int i = 0; i < 200000; i++)
+    {
+        string n = to_string(i);
+        source += "int v" + n + ";\nv" + n + " = (v" + n + " + " + n + ") * 2; // update\n";
+    }
+
+    NullBuffer null;
+    streambuf *console = cout.rdbuf();
+    cout << "pipeline: " << source.size() / 1e6 << " MB" << endl;
+
+    cout.rdbuf(&null);
+    double sequential = bestOf(3, [&]()
+    {
+        StringPool pool;
+        Lexer lexer(source, pool);
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(lexer), tacGen);
+        parser.parseProgram();
+    });
+    double pipelined = bestOf(3, [&]()
+    {
+        StringPool pool;
+        Lexer lexer(source, pool);
+        TokenRing ring;
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(ring), tacGen);
+        pair<Lexer *, TokenRing *> job(&lexer, &ring);
+        pthread_t tid;
+        pthread_create(&tid, NULL, produceTokensThread, &job);
+        parser.parseProgram();
+        pthread_join(tid, NULL);
+    });
+    cout.rdbuf(console);
+
+    report("sequential", sequential, source.size(), "B");
+    report("pipelined ", pipelined, source.size(), "B");
+}
+
+// ---------------------------------------------------------------------------
+// soa: memory per token and lex + parse throughput of the compact TokenStore
+// against a vector<Token>.
+
+void benchSoa()
+{
+    string source;
+    for (int i = 0; i < 200000; i++)
+    {
+        string n = to_string(i);
+        source += "int v" + n + ";\nv" + n + " = (v" + n + " + " + n + ") * 2;\n";
+    }
+
+    StringPool pool;
+    TokenStore store = Lexer(source, pool).tokenizeCompact();
+    size_t storeBytes = store.size() * TokenStore::BYTES_PER_TOKEN;
+    size_t vectorBytes = store.size() * sizeof(Token);
+    cout << "soa: " << store.size() << " tokens" << endl;
+    cout << "  vector<Token>: " << sizeof(Token) << " bytes/token, " << vectorBytes / 1e6 << " MB" << endl;
+    cout << "  TokenStore   : " << storeBytes / store.size() << " bytes/token, " << storeBytes / 1e6 << " MB" << endl;
+
+    NullBuffer null;
+    streambuf *console = cout.rdbuf();
+    cout.rdbuf(&null);
+    double lexArray = bestOf(3, [&]()
+    {
+        StringPool pool;
+        benchSink = Lexer(source, pool).tokenize().size();
+    });
+    double lexStore = bestOf(3, [&]()
+    {
+        StringPool pool;
+        benchSink = Lexer(source, pool).tokenizeCompact().size();
+    });
+    double parseArray = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        StringPool pool;
+        Parser parser(source, TokenStream(Lexer(source, pool).tokenize()), tacGen);
+        parser.parseProgram();
+    });
+    double parseStore = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        StringPool pool;
+        Parser parser(source, TokenStream(Lexer(source, pool).tokenizeCompact()), tacGen);
+        parser.parseProgram();
+    });
+    cout.rdbuf(console);
+
+    report("lex into vector<Token>  ", lexArray, source.size(), "B");
+    report("lex into TokenStore     ", lexStore, source.size(), "B");
+    report("lex + parse vector<Token>", parseArray, source.size(), "B");
+    report("lex + parse TokenStore  ", parseStore, source.size(), "B");
+}
+
+// ---------------------------------------------------------------------------
+// intern: symbol lookups for every identifier use, by interned id against the
+// previous name-keyed unordered_map.
+
+void benchIntern()
+{
+    string source;
+    for (int i = 0; i < 100000; i++)
+    {
+        string n = to_string(i % 5000);
+        source += "total = total + counter" + n + " * value" + n + ";\n";
+    }
+
+    StringPool pool;
+    TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+    unordered_map<string_view, Symbol> byName;
+    SymbolTable byId;
+    for (uint32_t id = 0; id < pool.size(); id++)
+    {
+        byName[pool.name(id)] = Symbol(pool.name(id), "int");
+        byId.addSymbol(id, pool.name(id), "int");
+    }
+
+    size_t uses = 0;
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        uses += tokens.kind(i) == T_ID;
+    }
+    cout << "intern: " << uses << " identifier uses, " << pool.size() << " distinct names" << endl;
+
+    double names = bestOf(5, [&]()
+    {
+        size_t found = 0;
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            if (tokens.kind(i) == T_ID)
+                found += byName.find(tokens.value(i)) != byName.end();
+        }
+        benchSink = found;
+    });
+    double ids = bestOf(5, [&]()
+    {
+        size_t found = 0;
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            if (tokens.kind(i) == T_ID)
+                found += byId.hasSymbol(tokens.symbolId(i));
+        }
+        benchSink = found;
+    });
+    report("by name", names, uses, "lookups");
+    report("by id  ", ids, uses, "lookups");
+}
+
+// ---------------------------------------------------------------------------
+// relex: one keystroke in the middle of growing files, relexed incrementally
+// against a full relex of the edited buffer.
+
+void benchRelex()
+{
+    cout << "relex: insert one character mid-file" << endl;
+    for (int lines : {10000, 100000, 1000000})
+    {
+        string source;
+        for (int i = 0; i < lines; i++)
+        {
+            string n = to_string(i);
+            source += "int v" + n + " = " + n + "; /* note */ v" + n + " = v" + n + " + 1;\n";
+        }
+        // Turn "v<mid> = v<mid> + 1" into "v<mid> = v<mid> + 12"
+        size_t offset = source.find(" + 1;", source.size() / 2) + 4;
+        string edited = source.substr(0, offset) + "2" + source.substr(offset);
+
+        // Each run types the character and deletes it again
+        StringPool pool;
+        TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+        double incremental = bestOf(5, [&]()
+        {
+            relex(tokens, edited, SourceEdit{offset, 0, "2"}, pool);
+            relex(tokens, source, SourceEdit{offset, 1, ""}, pool);
+            benchSink = tokens.size();
+        });
+        double full = bestOf(5, [&]()
+        {
+            benchSink = Lexer(edited, pool).tokenizeCompact().size();
+        });
+        cout << "  " << source.size() / 1e6 << " MB, " << tokens.size() << " tokens" << endl;
+        report("  incremental", incremental, 2, "edits");
+        report("  full       ", full, 1, "edits");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// reparse: one keystroke in the middle of growing files, relexed and
+// reparsed incrementally (reusing the untouched statements) against lexing
+// and parsing the edited buffer from scratch.
+
+void benchReparse()
+{
+    cout << "reparse: insert one character mid-file" << endl;
+    for (int lines : {2000, 20000, 200000})
+    {
+        string source;
+        for (int i = 0; i < lines; i += 2)
+        {
+            string v = "v" + to_string(i);
+            source += "int " + v + " = " + to_string(i) + ";\n";
+            source += "if (" + v + " > 10) { " + v + " = " + v + " * 2 + 1; } else { " + v + " = 0; }\n";
+        }
+        // Turn "v<mid> * 2 + 1" into "v<mid> * 2 + 12"
+        size_t offset = source.find(" + 1;", source.size() / 2) + 4;
+        string edited = source.substr(0, offset) + "2" + source.substr(offset);
+
+        // Each run types the character and deletes it again
+        StringPool pool;
+        TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(tokens), tacGen);
+        parser.parse();
+        double incremental = bestOf(5, [&]()
+        {
+            SourceEdit insert{offset, 0, "2"}, remove{offset, 1, ""};
+            parser.reparse(tokens, insert, relex(tokens, edited, insert, pool));
+            parser.reparse(tokens, remove, relex(tokens, source, remove, pool));
+            benchSink = parser.getProgram().count;
+        });
+        double full = bestOf(5, [&]()
+        {
+            TokenStore fresh = Lexer(edited, pool).tokenizeCompact();
+            TACGenerator tacGen;
+            Parser parser(edited, TokenStream(move(fresh)), tacGen);
+            benchSink = parser.parse().count;
+        });
+        cout << "  " << lines << " lines, " << tokens.size() << " tokens" << endl;
+        report("  incremental", incremental, 2, "edits");
+        report("  full       ", full, 1, "edits");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// cache: lexing a source cold against loading its tokens from a warm
+// TokenCache entry (mmap, hash check and decode into a TokenStore).
+
+void benchCache()
+{
+    string source;
+    for (int i = 0; i < 200000; i++)
+    {
+        string n = to_string(i % 5000);
+        source += "int v" + n + " = " + n + "; // counter\n";
+        source += "while (v" + n + " <= 100) { v" + n + " = v" + n + " * 2 + 1; }\n";
+        source += "float f" + n + " = 3.25; string s" + n + " = \"text\";\n";
+    }
+
+    char directory[] = "/tmp/fc-token-cache-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        cout << "cache: cannot create a temporary directory" << endl;
+        return;
+    }
+    TokenCache cache(directory);
+    uint64_t hash = hashSource(source);
+    {
+        StringPool pool;
+        cache.save(Lexer(source, pool).tokenizeCompact(), pool, hash);
+    }
+    MappedFile entry(cache.entryPath(hash));
+    cout << "cache: " << source.size() / 1e6 << " MB source, " << entry.view().size() / 1e6 << " MB cache entry" << endl;
+
+    size_t cold = 0, warm = 0;
+    double lexing = bestOf(5, [&]()
+    {
+        StringPool pool;
+        cold = Lexer(source, pool).tokenizeCompact().size();
+    });
+    double loading = bestOf(5, [&]()
+    {
+        StringPool pool;
+        TokenStore tokens;
+        if (cache.load(source, hashSource(source), pool, tokens))
+            warm = tokens.size();
+    });
+    if (cold != warm)
+        cout << "  token count mismatch: " << cold << " lexed, " << warm << " loaded" << endl;
+    report("cold lex  ", lexing, source.size(), "B");
+    report("warm load ", loading, source.size(), "B");
+
+    unlink(cache.entryPath(hash).c_str());
+    rmdir(directory);
+}
+
+// ---------------------------------------------------------------------------
+// expr: parsing (with folding, without lowering) of expression-heavy
+// statements from a pre-lexed TokenStore.
+
+void benchExpressions()
+{
+    string source;
+    for (int i = 0; i < 100000; i++)
+    {
+        string v = "v" + to_string(i);
+        source += "int " + v + " = " + to_string(i) + ";\n";
+        source += v + " = " + v + " * 2 + " + v + " / 3 - (" + v + " + 1) * " + v + " < " + v + " + 4 * 2;\n";
+    }
+
+    StringPool pool;
+    TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+    cout << "expr: " << source.size() / 1e6 << " MB, " << tokens.size() << " tokens" << endl;
+
+    double parsing = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(tokens), tacGen);
+        benchSink = parser.parse().count;
+    });
+    report("parse", parsing, tokens.size(), "tokens");
+}
+
+// ---------------------------------------------------------------------------
+// parse: parsing, checking and lowering of 1M top-level statements from a
+// pre-lexed TokenStore, on one thread and split across parser threads.
+
+bool sameOperand(const TACOperand &a, const TACOperand &b)
+{
+    return a.kind == b.kind && a.id == b.id && a.text == b.text;
+}
+
+bool sameCode(const TACGenerator &a, const TACGenerator &b)
+{
+    if (a.tac.size() != b.tac.size())
+        return false;
+    for (size_t i = 0; i < a.tac.size(); i++)
+    {
+        const TACInstruction &x = a.tac[i], &y = b.tac[i];
+        if (x.opcode != y.opcode || x.op != y.op || x.label != y.label || !sameOperand(x.result, y.result) ||
+            !sameOperand(x.arg1, y.arg1) || !sameOperand(x.arg2, y.arg2))
+            return false;
+    }
+    return true;
+}
+
+void benchParseParallel()
+{
+    string source;
+    for (int i = 0; i < 250000; i++)
+    {
+        string v = "v" + to_string(i);
+        source += "int " + v + " = " + to_string(i) + ";\n";
+        source += v + " = " + v + " * 2 + " + v + " / 3 - (" + v + " + 1);\n";
+        source += "if (" + v + " > 10) { " + v + " = " + v + " - 1; } else { " + v + " = " + v + " + 1; }\n";
+        source += "while (" + v + " > 100) { " + v + " = " + v + " / 2; }\n";
+    }
+
+    StringPool pool;
+    TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+    cout << "parse: 1000000 statements, " << tokens.size() << " tokens" << endl;
+
+    TACGenerator sequential;
+    Parser(source, TokenStream(tokens), sequential).compile();
+    double base = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(tokens), tacGen);
+        parser.compile();
+        benchSink = tacGen.tac.size();
+    });
+    report("1 thread", base, tokens.size(), "tokens");
+
+    for (size_t threads : {2, 4, 8})
+    {
+        TACGenerator parallel;
+        Parser parser(source, TokenStream(tokens), parallel);
+        parser.setParseThreads(threads);
+        parser.compile();
+        bool identical = sameCode(sequential, parallel);
+        double seconds = bestOf(3, [&]()
+        {
+            TACGenerator tacGen;
+            Parser parser(source, TokenStream(tokens), tacGen);
+            parser.setParseThreads(threads);
+            parser.compile();
+            benchSink = tacGen.tac.size();
+        });
+        report(to_string(threads) + " threads" + (identical ? "" : " (DIFFERS)"), seconds, tokens.size(), "tokens");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// nesting: parsing, checking and lowering of one deeply nested statement.
+// The parser keeps its own stacks, so time should grow linearly with depth
+// up to 1M levels of braces, parentheses or if statements.
+
+string nestedSource(const string &shape, int depth)
+{
+    string source = "int x = 1;\n";
+    if (shape == "blocks")
+    {
+        source += string(depth, '{') + " x = 2; " + string(depth, '}');
+    }
+    else if (shape == "parens")
+    {
+        source += "x = ";
+        for (int i = 0; i < depth; i++)
+            source += "(x + ";
+        source += "x" + string(depth, ')') + ";";
+    }
+    else
+    {
+        for (int i = 0; i < depth; i++)
+            source += "if (x) ";
+        source += "x = 3;";
+    }
+    return source + "\n";
+}
+
+void benchNesting()
+{
+    cout << "nesting: one statement nested to the given depth" << endl;
+    for (const char *shape : {"blocks", "parens", "ifs"})
+    {
+        for (int depth : {1000, 10000, 100000, 1000000})
+        {
+            string source = nestedSource(shape, depth);
+            StringPool pool;
+            TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+            bool ok = true;
+            double seconds = bestOf(3, [&]()
+            {
+                TACGenerator tacGen;
+                Parser parser(source, TokenStream(tokens), tacGen);
+                ok = parser.compile();
+                benchSink = tacGen.tac.size();
+            });
+            report(string(shape) + " x" + to_string(depth) + (ok ? "" : " (FAILED)"), seconds, depth, "levels");
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// dispatch: parsing of short statements of every kind, where picking the
+// statement rule is a large share of the work, and constructing Parsers
+// for an empty source.
+
+void benchDispatch()
+{
+    string source = "int x = 0; float f; string s; bool b;\n";
+    for (int i = 0; i < 200000; i++)
+    {
+        source += "x = 1; { } if (b) x = 2; while (x) { } for (x = 0; x; x + 1) { } do { { } } while (b); return x;\n";
+    }
+
+    StringPool pool;
+    TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+    cout << "dispatch: " << tokens.size() << " tokens" << endl;
+    double parsing = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(tokens), tacGen);
+        benchSink = parser.parse().count;
+    });
+    report("parse", parsing, tokens.size(), "tokens");
+
+    TokenStore empty = Lexer("", pool).tokenizeCompact();
+    const int parsers = 100000;
+    double constructing = bestOf(3, [&]()
+    {
+        for (int i = 0; i < parsers; i++)
+        {
+            TACGenerator tacGen;
+            Parser parser("", TokenStream(empty), tacGen);
+            benchSink = benchSink + 1;
+        }
+    });
+    report("construct Parser", constructing, parsers, "parsers");
+}
+
+// ---------------------------------------------------------------------------
+// scopes: checking many small blocks that each declare and use a few local
+// names, where entering and leaving a scope is a large share of the work.
+// The scope-stack-of-maps row is the classic layout the SymbolTable undo
+// log replaces.
+
+void benchScopes()
+{
+    string source = "int x = 0;\n";
+    for (int i = 0; i < 100000; i++)
+    {
+        source += "{ int a = x; { int x = a + 1; a = x; } float f; { int a = 2; x = a; } }\n";
+    }
+
+    StringPool pool;
+    TokenStore tokens = Lexer(source, pool).tokenizeCompact();
+    const int blocks = 300000;
+    cout << "scopes: " << blocks << " blocks" << endl;
+    double checking = bestOf(3, [&]()
+    {
+        TACGenerator tacGen;
+        Parser parser(source, TokenStream(tokens), tacGen);
+        benchSink = parser.parse().count + parser.getDiagnostics().size();
+    });
+    report("parse + check", checking, blocks, "blocks");
+
+    vector<uint32_t> ids;
+    for (const char *name : {"a", "x", "f"})
+    {
+        ids.push_back(pool.intern(name));
+    }
+    double undoLog = bestOf(5, [&]()
+    {
+        SymbolTable table;
+        size_t found = 0;
+        for (int i = 0; i < blocks; i++)
+        {
+            table.enterScope();
+            for (uint32_t id : ids)
+            {
+                table.addSymbol(id, pool.name(id), "int");
+                found += table.hasSymbol(id);
+            }
+            table.exitScope();
+        }
+        benchSink = found;
+    });
+    double maps = bestOf(5, [&]()
+    {
+        vector<unordered_map<string_view, Symbol>> scopes(1);
+        size_t found = 0;
+        for (int i = 0; i < blocks; i++)
+        {
+            scopes.emplace_back();
+            for (uint32_t id : ids)
+            {
+                scopes.back()[pool.name(id)] = Symbol(pool.name(id), "int");
+                for (size_t s = scopes.size(); s-- > 0;)
+                {
+                    if (scopes[s].count(pool.name(id)))
+                    {
+                        found++;
+                        break;
+                    }
+                }
+            }
+            scopes.pop_back();
+        }
+        benchSink = found;
+    });
+    report("undo log        ", undoLog, blocks, "scopes");
+    report("stack of maps   ", maps, blocks, "scopes");
+}
+
+// ---------------------------------------------------------------------------
+// names: interning and looking up a million distinct identifiers in the
+// Robin Hood FlatNameMap behind StringPool, against the node-based
+// unordered_map it replaced.
+
+void benchNames()
+{
+    const size_t count = 1000000;
+    string source;
+    for (size_t i = 0; i < count; i++)
+    {
+        source += "name" + to_string(i * 2654435761u % 100000007) + " ";
+    }
+    vector<string_view> names;
+    for (size_t start = 0; start < source.size();)
+    {
+        size_t end = source.find(' ', start);
+        names.push_back(string_view(source).substr(start, end - start));
+        start = end + 1;
+    }
+
+    cout << "names: " << names.size() << " distinct identifiers" << endl;
+    FlatNameMap flat;
+    double flatInsert = bestOf(3, [&]()
+    {
+        flat = FlatNameMap();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            bool inserted;
+            flat.findOrInsert(names[i], static_cast<uint32_t>(i), inserted);
+        }
+        benchSink = flat.size();
+    });
+    unordered_map<string_view, uint32_t> nodes;
+    double nodeInsert = bestOf(3, [&]()
+    {
+        nodes = unordered_map<string_view, uint32_t>();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            nodes.try_emplace(names[i], static_cast<uint32_t>(i));
+        }
+        benchSink = nodes.size();
+    });
+    report("insert, flat map     ", flatInsert, names.size(), "names");
+    report("insert, unordered_map", nodeInsert, names.size(), "names");
+
+    double flatFind = bestOf(5, [&]()
+    {
+        size_t sum = 0;
+        for (size_t i = names.size(); i-- > 0;)
+        {
+            sum += *flat.find(names[i]);
+        }
+        benchSink = sum;
+    });
+    double nodeFind = bestOf(5, [&]()
+    {
+        size_t sum = 0;
+        for (size_t i = names.size(); i-- > 0;)
+        {
+            sum += nodes.find(names[i])->second;
+        }
+        benchSink = sum;
+    });
+    report("find, flat map       ", flatFind, names.size(), "names");
+    report("find, unordered_map  ", nodeFind, names.size(), "names");
+
+    double lex = bestOf(3, [&]()
+    {
+        StringPool pool;
+        benchSink = Lexer(source, pool).tokenizeCompact().size() + pool.size();
+    });
+    report("Lexer::tokenizeCompact", lex, names.size(), "names");
+}
+
+// ---------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    vector<pair<string, function<void()>>> benchmarks = {
+        {"keywords", benchKeywords},
+        {"scan", benchScan},
+        {"dfa", benchDfa},
+        {"parallel", benchParallel},
+        {"pipeline", benchPipeline},
+        {"soa", benchSoa},
+        {"intern", benchIntern},
+        {"relex", benchRelex},
+        {"reparse", benchReparse},
+        {"cache", benchCache},
+        {"expr", benchExpressions},
+        {"parse", benchParseParallel},
+        {"nesting", benchNesting},
+        {"dispatch", benchDispatch},
+        {"scopes", benchScopes},
+        {"names", benchNames},
+    };
+
+    for (auto &benchmark : benchmarks)
+    {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++)
+        {
+            selected = selected || benchmark.first == argv[i];
+        }
+        if (selected)
+        {
+            benchmark.second();
+        }
+    }
+    return 0;
+}
@@ -1,13 +1,30 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cctype>
 #include <map>
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
 #include <sstream>
 #include <regex>
 #include "pthread.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <sched.h>
+#include <algorithm>
+#include <climits>
+#include <charconv>
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 // #include <mutex>
 // #include <bits/std_mutex.h>
 
@@ -48,828 +65,3766 @@ enum TokenTypeValue
     T_NEQ,
     T_GE,
     T_LE,
-    T_DO
+    T_DO,
+    T_AND,
+    T_OR,
+    T_ERROR,
+    TOKEN_TYPE_COUNT
 };
 
-struct Token
+// symbolId of every token that is not an identifier.
+const uint32_t NO_SYMBOL = UINT32_MAX;
+
+// Token values are views into the source buffer handed to the Lexer, so that
+// buffer must outlive every Token, Symbol and Parser built from it.
+// Identifiers also carry the id their name was interned under, and numeric
+// literals the value the Lexer decoded: intValue for T_NUM, floatValue for
+// T_FLOAT_LITERAL. Tokens do not record a line; a LineIndex over the source
+// resolves one from value.data() when a diagnostic needs it.
+union NumericLiteral
 {
-    TokenTypeValue type;
-    string value;
-    size_t lineNo;
+    int64_t intValue;
+    double floatValue;
 };
 
-struct Symbol
+struct Token
 {
-    string name;
-    string type;
-    // Default constructor
-    Symbol() : name(""), type("") {}
-
-    Symbol(const string name, const string type)
-        : name(name), type(type) {}
+    TokenTypeValue type;
+    uint32_t symbolId;
+    string_view value;
+    NumericLiteral literal{};
 };
 
-struct SymbolTable
+inline bool isNumericLiteral(TokenTypeValue type)
 {
-    unordered_map<string, Symbol> table;
+    return type == T_NUM || type == T_FLOAT_LITERAL;
+}
 
-    void addSymbol(const string &name, const string &type)
+// Open-addressing hash map from names to ids with Robin Hood probing. Every
+// slot lives in one flat array and stores its name's hash, so a probe skips
+// other names without touching their bytes. An entry that has probed further
+// from its home slot than the one it meets takes that slot over, which keeps
+// probe runs short and lets a miss stop as soon as it meets an entry closer
+// to home than itself.
+class FlatNameMap
+{
+public:
+    // The value stored under name, inserting value first if name is new. One
+    // probe serves both the lookup and the insert.
+    uint32_t &findOrInsert(string_view name, uint32_t value, bool &inserted)
     {
-        if (table.find(name) != table.end())
+        if ((count + 1) * 5 > slots.size() * 4)
         {
-            cout << "Error: Redeclaration of symbol '" << name << "'" << endl;
-            exit(1);
+            rehash(max<size_t>(16, slots.size() * 2));
         }
-        table[name] = Symbol(name, type);
-    }
-    bool hasSymbol(const string &name)
-    {
-        return table.find(name) != table.end();
-    }
-    string getVariableType(const string &name)
-    {
-        if (table.find(name) == table.end())
+        uint32_t hash = hashOf(name);
+        size_t index = hash & mask;
+        for (size_t distance = 0;; distance++, index = (index + 1) & mask)
         {
-            throw runtime_error("Semantic error: Variable '" + name + "' is not declared.");
+            Slot &slot = slots[index];
+            if (slot.hash == EMPTY)
+            {
+                slot = Slot{name, hash, value};
+                count++;
+                inserted = true;
+                return slot.value;
+            }
+            if (slot.hash == hash && slot.name == name)
+            {
+                inserted = false;
+                return slot.value;
+            }
+            if (distanceOf(slot, index) < distance)
+            {
+                // name is not present and belongs here; shift the rest of
+                // the run along by one.
+                Slot displaced = slot;
+                slot = Slot{name, hash, value};
+                count++;
+                place(displaced, (index + 1) & mask);
+                inserted = true;
+                return slot.value;
+            }
         }
-        return table[name].type;
     }
 
-    Symbol getSymbol(const string &name)
+    // The value stored under name, or nullptr.
+    const uint32_t *find(string_view name) const
     {
-        if (table.find(name) == table.end())
+        if (count == 0)
         {
-            cout << "Error: Symbol '" << name << "' not found" << endl;
-            exit(1);
+            return nullptr;
+        }
+        uint32_t hash = hashOf(name);
+        size_t index = hash & mask;
+        for (size_t distance = 0;; distance++, index = (index + 1) & mask)
+        {
+            const Slot &slot = slots[index];
+            if (slot.hash == EMPTY || distanceOf(slot, index) < distance)
+            {
+                return nullptr;
+            }
+            if (slot.hash == hash && slot.name == name)
+            {
+                return &slot.value;
+            }
         }
-        return table[name];
     }
 
-    void display()
+    size_t size() const { return count; }
+
+    void reserve(size_t entries)
     {
-        cout << "\nSymbol Table:\n";
-        cout << "Name\tType\n";
-        for (auto &entry : table)
+        size_t capacity = 16;
+        while (entries * 5 > capacity * 4)
         {
-            cout << entry.second.name << "\t" << entry.second.type << "\t"
-                 << endl;
+            capacity *= 2;
+        }
+        if (capacity > slots.size())
+        {
+            rehash(capacity);
         }
     }
-};
 
-class TACGenerator
-{
-public:
-    void generate(const string &op, const string &arg1, const string &arg2, const string &result)
-    {
-        tac.push_back(result + " = " + arg1 + " " + op + " " + arg2);
-    }
+private:
+    static constexpr uint32_t EMPTY = 0;
 
-    void generateAssign(const string &var, const string &value)
+    struct Slot
     {
-        tac.push_back(var + " = " + value);
-    }
+        string_view name;
+        uint32_t hash; // EMPTY for a free slot
+        uint32_t value;
+    };
 
-    void printTAC()
-    {
-        cout << "Three Address Code:" << endl;
-        for (const auto &line : tac)
-        {
-            cout << line << endl;
-        }
-    }
+    vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
 
-    string generateLabel(const string &base)
+    static uint32_t hashOf(string_view name)
     {
-        static int labelCount = 0;
-        return base + to_string(labelCount++);
+        uint32_t hash = static_cast<uint32_t>(std::hash<string_view>()(name));
+        return hash == EMPTY ? 1 : hash;
     }
 
-    void generateIfGoto(const string &condition, const string &label)
+    // How far the entry in slot index sits from its home slot.
+    size_t distanceOf(const Slot &slot, size_t index) const
     {
-        tac.push_back("if " + condition + " goto " + label);
+        return (index - (slot.hash & mask)) & mask;
     }
 
-    void generateAssembly()
+    // Robin Hood insert of an entry known to be absent, starting at index.
+    void place(Slot entry, size_t index)
     {
-        cout << "\nGenerated Assembly Code:" << endl;
-        for (const auto &line : tac)
+        for (;; index = (index + 1) & mask)
         {
-            parseTACtoAssembly(line);
+            Slot &slot = slots[index];
+            if (slot.hash == EMPTY)
+            {
+                slot = entry;
+                return;
+            }
+            if (distanceOf(slot, index) < distanceOf(entry, index))
+            {
+                swap(slot, entry);
+            }
         }
     }
 
-    vector<string> tac;
-
-private:
-    void parseTACtoAssembly(const string &line)
+    void rehash(size_t capacity)
     {
-
-        size_t equalPos = line.find("=");
-        size_t opPos = line.find_first_of("+-*/", equalPos);
-
-        string result = line.substr(0, equalPos - 1);
-        string arg1, arg2, op;
-
-        if (opPos != string::npos)
-        {
-
-            op = line.substr(opPos, 1);
-            arg1 = line.substr(equalPos + 2, opPos - (equalPos + 2));
-            arg2 = line.substr(opPos + 2);
-
-            cout << "MOV AX, " << arg1 << endl;
-            if (op == "+")
-                cout << "ADD AX, " << arg2 << endl;
-            else if (op == "-")
-                cout << "SUB AX, " << arg2 << endl;
-            else if (op == "*")
-                cout << "MUL " << arg2 << endl;
-            else if (op == "/")
-                cout << "DIV " << arg2 << endl;
-            cout << "MOV " << result << ", AX" << endl;
-        }
-        else
+        vector<Slot> old(capacity, Slot{string_view(), EMPTY, 0});
+        old.swap(slots);
+        mask = capacity - 1;
+        for (const Slot &slot : old)
         {
-
-            arg1 = line.substr(equalPos + 2);
-            cout << "MOV " << result << ", " << arg1 << endl;
+            if (slot.hash != EMPTY)
+            {
+                place(slot, slot.hash & mask);
+            }
         }
     }
 };
 
-class Lexer
+// Identifier names are interned once, as the Lexer sees them: each distinct
+// name gets a dense id, and later phases work with the id instead of hashing
+// the name again. Names are views into the source buffer.
+class StringPool
 {
-private:
-    string src;
-    size_t pos;
-    size_t lineNo;
-
 public:
-    Lexer(const string &src)
+    uint32_t intern(string_view name)
     {
-        this->src = src;
-        this->pos = 0;
-        this->lineNo = 0;
+        bool inserted;
+        uint32_t id = ids.findOrInsert(name, static_cast<uint32_t>(names.size()), inserted);
+        if (inserted)
+        {
+            names.push_back(name);
+        }
+        return id;
     }
 
-    vector<Token> tokenize()
+    string_view name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+    void reserve(size_t count)
     {
-        vector<Token> tokens;
-        while (pos < src.size())
-        {
-            char current = src[pos];
-            if (current == '/')
-            {
-                if (pos + 1 < src.size())
-                {
-                    if (src[pos + 1] == '/')
-                    {
-                        while (current != '\n')
-                        {
-                            pos++;
-                            current = src[pos];
-                        }
-                        this->lineNo++;
-                        pos++;
-                        continue;
-                    }
-                    else if (src[pos + 1] == '*')
-                    {
-                        while (true)
-                        {
-                            pos++;
-                            current = src[pos];
-                            if (current == '\n')
-                            {
-                                this->lineNo++;
-                            }
-                            else if (current == '*')
-                            {
-                                if (pos + 1 < src.size())
-                                {
-                                    if (src[pos + 1] == '/')
-                                    {
-                                        pos++;
-                                        current = src[pos];
-                                        if (pos + 1 < src.size())
-                                        {
-                                            pos++;
-                                            current = src[pos];
-                                        }
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        ids.reserve(count);
+        names.reserve(count);
+    }
 
-            if (current == '\n')
-            {
-                this->lineNo++;
-                pos++;
-                continue;
-            }
-            if (isspace(current))
-            {
-                pos++;
-                continue;
-            }
-            if (isdigit(current))
-            {
-                tokens.push_back(Token{T_NUM, consumeNumber(), this->lineNo});
-                continue;
-            }
-            if (isalpha(current))
-            {
-                string word = consumeWord();
-                if (word == "int")
-                {
-                    tokens.push_back(Token{T_INT, word, this->lineNo});
-                }
-                else if (word == "float")
-                {
-                    tokens.push_back(Token{T_FLOAT, word, this->lineNo});
-                }
-                else if (word == "bool")
-                {
-                    tokens.push_back(Token{T_BOOL, word, this->lineNo});
-                }
-                else if (word == "true" || word == "false")
-                    tokens.push_back(Token{T_BOOL_LITERAL, word, lineNo});
-                else if (word == "if")
-                    tokens.push_back(Token{T_IF, word, this->lineNo});
-                else if (word == "string")
-                    tokens.push_back(Token{T_STRING, word, this->lineNo});
-                else if (word == "else")
-                    tokens.push_back(Token{T_ELSE, word, this->lineNo});
-                else if (word == "for")
-                    tokens.push_back(Token{T_FOR, word, this->lineNo});
-                else if (word == "while")
-                    tokens.push_back(Token{T_WHILE, word, this->lineNo});
-                else if (word == "do")
-                    tokens.push_back(Token{T_DO, word, this->lineNo});
-                else if (word == "return")
-                    tokens.push_back(Token{T_RETURN, word, this->lineNo});
-                else
-                    tokens.push_back(Token{T_ID, word, this->lineNo});
-                continue;
-            }
+private:
+    FlatNameMap ids;
+    vector<string_view> names;
+};
 
-            if (current == '"')
-            {
-                // Handle string literals
-                tokens.push_back(Token{T_STRING_LITERAL, consumeString(), lineNo});
-                continue;
-            }
+// Compact structure-of-arrays token storage: one kind byte plus a 32-bit
+// source offset, length and payload per token (13 bytes, against 32 for a
+// Token). The payload is the symbol id of an identifier, or for a numeric
+// literal the index of its decoded value in literals.
+class TokenStore
+{
+public:
+    static const size_t BYTES_PER_TOKEN = sizeof(uint8_t) + 3 * sizeof(uint32_t);
 
-            switch (current)
-            {
-            case '=':
-                if (pos + 1 < src.size() && src[pos + 1] == '=')
-                {
-                    pos++;
-                    tokens.push_back(Token{T_EQ, "==", lineNo});
-                }
-                else
-                {
-                    tokens.push_back(Token{T_ASSIGN, "=", lineNo});
-                }
-                break;
-            case '!':
-                if (pos + 1 < src.size() && src[pos + 1] == '=')
-                {          // Lookahead
-                    pos++; // Consume the '='
-                    tokens.push_back(Token{T_NEQ, "!=", lineNo});
-                }
-                else
-                {
-                    cerr << "Unexpected character '!' at line " << lineNo << "\n";
-                    exit(1);
-                }
-                break;
-            case '+':
-                tokens.push_back(Token{T_PLUS, "+", this->lineNo});
-                break;
-            case '-':
-                tokens.push_back(Token{T_MINUS, "-", this->lineNo});
-                break;
-            case '*':
-                tokens.push_back(Token{T_MUL, "*", this->lineNo});
-                break;
-            case '/':
-                tokens.push_back(Token{T_DIV, "/", this->lineNo});
-                break;
-            case '(':
-                tokens.push_back(Token{T_LPAREN, "(", this->lineNo});
-                break;
-            case ')':
-                tokens.push_back(Token{T_RPAREN, ")", this->lineNo});
-                break;
-            case '{':
-                tokens.push_back(Token{T_LBRACE, "{", this->lineNo});
-                break;
-            case '}':
-                tokens.push_back(Token{T_RBRACE, "}", this->lineNo});
-                break;
-            case ';':
-                tokens.push_back(Token{T_SEMICOLON, ";", this->lineNo});
-                break;
-            case '>':
-                // Check if the next character is '=' for the >= operator
-                if (pos + 1 < src.size() && src[pos + 1] == '=')
-                {
-                    tokens.push_back(Token{T_GE, ">=", this->lineNo}); // Greater than or equal to
-                    pos++;                                             // Move past the '=' character
-                }
-                else
-                {
-                    tokens.push_back(Token{T_GT, ">", this->lineNo}); // Just '>'
-                }
-                break;
+    TokenStore() {}
 
-            case '<':
-                // Check if the next character is '=' for the <= operator
-                if (pos + 1 < src.size() && src[pos + 1] == '=')
-                {
-                    tokens.push_back(Token{T_LE, "<=", this->lineNo}); // Less than or equal to
-                    pos++;                                             // Move past the '=' character
-                }
-                else
-                {
-                    tokens.push_back(Token{T_LT, "<", this->lineNo}); // Just '<'
-                }
-                break;
-            default:
-                cout << "Unexpected character: " << current << endl;
-                exit(1);
-            }
-            pos++;
-        }
-        tokens.push_back(Token{T_EOF, "", this->lineNo});
-        return tokens;
+    TokenStore(string_view src) : src(src) {}
+
+    // Offsets and lengths are 32-bit, so only the tokens of a source of up
+    // to 4 GB can be stored; the Lexer turns a larger one into an error.
+    static bool fits(string_view source)
+    {
+        return source.size() <= UINT32_MAX;
     }
 
-    string consumeNumber()
+    void push(const Token &token)
     {
-        size_t start = pos;
-        while (pos < src.size() && (isdigit(src[pos]) || src[pos] == '.'))
-            pos++;
-        return src.substr(start, pos - start);
+        kinds.push_back(static_cast<uint8_t>(token.type));
+        offsets.push_back(static_cast<uint32_t>(token.value.data() - src.data()));
+        lengths.push_back(static_cast<uint32_t>(token.value.size()));
+        payloads.push_back(isNumericLiteral(token.type) ? storeLiteral(token.literal) : token.symbolId);
     }
 
-    string consumeWord()
+    // Appends the first count tokens of other, which must view the same
+    // source. other's symbol ids are translated through remap.
+    void append(const TokenStore &other, size_t count, const vector<uint32_t> &remap)
     {
-        size_t start = pos;
-        while (pos < src.size() && isalnum(src[pos]))
+        kinds.insert(kinds.end(), other.kinds.begin(), other.kinds.begin() + count);
+        offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.begin() + count);
+        lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.begin() + count);
+        uint32_t literalBase = static_cast<uint32_t>(literals.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t payload = other.payloads[i];
+            if (isNumericLiteral(other.kind(i)))
+                payloads.push_back(literalBase + payload);
+            else
+                payloads.push_back(payload == NO_SYMBOL ? NO_SYMBOL : remap[payload]);
+        }
+        literals.insert(literals.end(), other.literals.begin(), other.literals.end());
+        for (uint32_t slot : other.freeLiterals)
         {
-            pos++;
+            freeLiterals.push_back(literalBase + slot);
         }
-        return src.substr(start, pos - start);
     }
 
-    string consumeString()
+    // Moves the store onto source, an edited copy of its old source: tokens
+    // [first, last) are replaced by replacement, which views source, and the
+    // offsets of the tokens after them move by shift. The side-array slots
+    // of replaced numeric literals are reused for new ones, so repeated
+    // edits do not grow it. source must fit().
+    void splice(string_view source, size_t first, size_t last, const vector<Token> &replacement, ptrdiff_t shift)
     {
-        size_t start = pos;
-        if (src[pos] != '"') // Check if it's not a double quote
+        src = source;
+        for (size_t i = first; i < last; i++)
+        {
+            if (isNumericLiteral(kind(i)))
+            {
+                freeLiterals.push_back(payloads[i]);
+            }
+        }
+        vector<uint8_t> newKinds;
+        vector<uint32_t> newOffsets, newLengths, newPayloads;
+        for (const Token &token : replacement)
         {
-            cerr << "Error: String literal should start with a double quote at line " << lineNo << "\n";
-            exit(1); // Exit on error
+            newKinds.push_back(static_cast<uint8_t>(token.type));
+            newOffsets.push_back(static_cast<uint32_t>(token.value.data() - src.data()));
+            newLengths.push_back(static_cast<uint32_t>(token.value.size()));
+            newPayloads.push_back(isNumericLiteral(token.type) ? storeLiteral(token.literal) : token.symbolId);
         }
-        pos++;
-        while (pos < src.size() && src[pos] != '"')
-            pos++;
-        if (pos >= src.size())
+        spliceColumn(kinds, first, last, newKinds);
+        spliceColumn(offsets, first, last, newOffsets);
+        spliceColumn(lengths, first, last, newLengths);
+        spliceColumn(payloads, first, last, newPayloads);
+        uint32_t delta = static_cast<uint32_t>(shift);
+        for (size_t i = first + replacement.size(); i < offsets.size(); i++)
         {
-            cerr << "Error: Unterminated string literal\n";
-            exit(1);
+            offsets[i] += delta;
         }
-        pos++;
-        return src.substr(start, pos - start);
     }
-};
-
-class Parser
-{
-    string currentScope = "global";
 
-public:
-    Parser(const vector<Token> &tokens, TACGenerator &tacGen) : tacGen(tacGen)
-    {
-        this->tokens = tokens;
-        this->pos = 0;
-        tokenMap[T_INT] = "int";
-        tokenMap[T_ID] = "identifier";
-        tokenMap[T_NUM] = "number";
-        tokenMap[T_FLOAT] = "float";
-        tokenMap[T_IF] = "if";
-        tokenMap[T_ELSE] = "else";
-        tokenMap[T_RETURN] = "return";
-        tokenMap[T_ASSIGN] = "=";
-        tokenMap[T_PLUS] = "+";
-        tokenMap[T_MINUS] = "-";
-        tokenMap[T_EQ] = "==";
-        tokenMap[T_NEQ] = "!=";
-        tokenMap[T_MUL] = "*";
-        tokenMap[T_DIV] = "/";
-        tokenMap[T_LPAREN] = "(";
-        tokenMap[T_RPAREN] = ")";
-        tokenMap[T_LBRACE] = "{";
-        tokenMap[T_RBRACE] = "}";
-        tokenMap[T_SEMICOLON] = ";";
-        tokenMap[T_GT] = ">";
-        tokenMap[T_LT] = "<";
-        tokenMap[T_EOF] = "end of file";
-        tokenMap[T_BOOL] = "bool";
-        tokenMap[T_FOR] = "for";
-        tokenMap[T_WHILE] = "while";
-        tokenMap[T_STRING] = "string";
-    }
-
-    void parseProgram()
-    {
-        while (tokens[pos].type != T_EOF)
-        {
-            parseStatement();
-        }
-        cout << "Parsing completed successfully! No Syntax Error" << endl;
-        symbolTable.display();
-        tacGen.printTAC();
-        tacGen.generateAssembly();
+    // Index of the first token at or after from that starts at or after
+    // offset.
+    size_t lowerBound(size_t offset, size_t from = 0) const
+    {
+        return lower_bound(offsets.begin() + from, offsets.end(), offset) - offsets.begin();
     }
 
-private:
-    vector<Token> tokens;
-    size_t pos;
-    SymbolTable symbolTable;
-    TACGenerator &tacGen;
+    void reserve(size_t count)
+    {
+        kinds.reserve(count);
+        offsets.reserve(count);
+        lengths.reserve(count);
+        payloads.reserve(count);
+    }
 
-    unordered_map<int, string> tokenMap;
-    int tempCount = 0;
+    size_t size() const { return kinds.size(); }
+    string_view source() const { return src; }
+    TokenTypeValue kind(size_t i) const { return static_cast<TokenTypeValue>(kinds[i]); }
+    size_t offset(size_t i) const { return offsets[i]; }
+    string_view value(size_t i) const { return src.substr(offsets[i], lengths[i]); }
+    size_t end(size_t i) const { return offsets[i] + lengths[i]; }
+    uint32_t symbolId(size_t i) const { return isNumericLiteral(kind(i)) ? NO_SYMBOL : payloads[i]; }
+    NumericLiteral literal(size_t i) const { return literals[payloads[i]]; }
 
-    void parseStatement()
+    Token token(size_t i) const
     {
-        if (tokens[pos].type == T_INT)
-        {
-            parseDeclaration();
-        }
-        else if (tokens[pos].type == T_FLOAT)
-        {
-            parseDeclaration();
-        }
-        else if (tokens[pos].type == T_STRING)
-        {
-            parseDeclaration();
-        }
-        else if (tokens[pos].type == T_BOOL)
-        {
-            parseDeclaration();
-        }
-        else if (tokens[pos].type == T_FOR)
-        {
-            parseForLoop();
-        }
-        else if (tokens[pos].type == T_WHILE)
-        {
-            parseWhileLoop();
-        }
-        else if (tokens[pos].type == T_ID)
-        {
-            parseAssignment();
-        }
-        else if (tokens[pos].type == T_IF)
-        {
-            parseIfStatement();
-        }
-        else if (tokens[pos].type == T_RETURN)
-        {
-            parseReturnStatement();
-        }
-        else if (tokens[pos].type == T_LBRACE)
+        if (isNumericLiteral(kind(i)))
         {
-            parseBlock();
+            return Token{kind(i), NO_SYMBOL, value(i), literal(i)};
         }
+        return Token{kind(i), payloads[i], value(i)};
+    }
 
-        else if (tokens[pos].type == T_DO)
-        {
-            parseDoWhileLoop();
-        }
+private:
+    string_view src;
+    vector<uint8_t> kinds;
+    vector<uint32_t> offsets;
+    vector<uint32_t> lengths;
+    vector<uint32_t> payloads;
+    vector<NumericLiteral> literals;
+    vector<uint32_t> freeLiterals; // slots of literals no token uses
 
-        else
+    // Stores value in a free slot of literals, or a new one, and returns
+    // its index.
+    uint32_t storeLiteral(NumericLiteral value)
+    {
+        if (freeLiterals.empty())
         {
-            cout << "Syntax error: unexpected token " << tokens[pos].value << endl;
-            exit(1);
+            literals.push_back(value);
+            return static_cast<uint32_t>(literals.size() - 1);
         }
+        uint32_t slot = freeLiterals.back();
+        freeLiterals.pop_back();
+        literals[slot] = value;
+        return slot;
     }
 
-    string generateLabel(const string &base)
+    template <typename T>
+    static void spliceColumn(vector<T> &column, size_t first, size_t last, const vector<T> &replacement)
     {
-        static int labelCount = 0;
-        return base + to_string(labelCount++);
+        size_t removed = last - first;
+        if (replacement.size() > removed)
+            column.insert(column.begin() + last, replacement.size() - removed, T());
+        else
+            column.erase(column.begin() + first + replacement.size(), column.begin() + last);
+        copy(replacement.begin(), replacement.end(), column.begin() + first);
     }
+};
 
-    void parseDoWhileLoop()
-    {
-        expect(T_DO); // Expect 'do'
+struct Symbol
+{
+    string_view name;
+    string_view type;
+    // Default constructor
+    Symbol() : name(""), type("") {}
 
-        string startLabel = generateLabel("L");
-        tacGen.generateLabel(startLabel); // Generate start label
+    Symbol(string_view name, string_view type)
+        : name(name), type(type) {}
+};
 
-        expect(T_LBRACE); // Expect '{'
-        parseBlock();     // Parse the block
-        expect(T_RBRACE); // Expect '}'
+// Symbols are indexed by the id the Lexer interned their name under, so a
+// lookup is an array access rather than a hash of the name.
+//
+// Scopes nest. Every declaration is an entry in one flat array, kept in
+// declaration order for the listing; visible[id] is the innermost entry for
+// a name and each entry links to the one it shadows. Declarations in open
+// inner scopes are also pushed on an undo log, and leaving a scope pops its
+// run of the log and restores what each entry shadowed. Entering and
+// leaving are O(1) amortized and no scope allocates a map of its own.
+//
+// Every declaration is its own variable. The second and later declarations
+// of a name, in shadowing or sibling scopes, are listed and lowered as
+// name.1, name.2 and so on.
+struct SymbolTable
+{
+    static constexpr uint32_t NO_ENTRY = UINT32_MAX;
 
-        expect(T_WHILE);  // Expect 'while'
-        expect(T_LPAREN); // Expect '(' for condition
+    struct Entry
+    {
+        Symbol symbol;
+        uint32_t id;
+        uint32_t shadowed; // the entry this one hides, or NO_ENTRY
+        uint32_t depth;    // 0 for the global scope
+        uint32_t version;  // earlier declarations of the same name
+        bool renamed;      // symbol.name already carries the version
+    };
 
-        string condition = parseCondition(); // Parse the condition
-        expect(T_RPAREN);                    // Expect ')' after condition
-        expect(T_SEMICOLON);                 // Expect ';'
+    vector<Entry> entries;
+    vector<uint32_t> visible;   // by symbol id, NO_ENTRY if out of scope
+    vector<uint32_t> undoLog;   // entries declared in the open inner scopes
+    vector<size_t> scopeStarts; // undoLog size as each inner scope opened
+    vector<uint32_t> declarations; // by symbol id, how many entries it has
+    size_t redeclarations = 0;     // entries with a version
+    deque<string> versionedNames;  // storage for the name.N names
 
-        tacGen.generateIfGoto(condition, startLabel); // Generate TAC to loop back
+    void enterScope()
+    {
+        scopeStarts.push_back(undoLog.size());
     }
 
-    void parseBlock()
+    void exitScope()
     {
-        expect(T_LBRACE);
-        while (tokens[pos].type != T_RBRACE && tokens[pos].type != T_EOF)
+        size_t start = scopeStarts.back();
+        scopeStarts.pop_back();
+        for (size_t i = undoLog.size(); i-- > start;)
         {
-            parseStatement();
+            const Entry &entry = entries[undoLog[i]];
+            visible[entry.id] = entry.shadowed;
         }
-        expect(T_RBRACE);
+        undoLog.resize(start);
     }
 
-    void parseDeclaration()
+    uint32_t depth() const
     {
-        Token typeToken = tokens[pos++];
-        Token idToken = tokens[pos++];
-
-        if (idToken.type != T_ID)
-        {
-            cerr << "Syntax error: Expected identifier\n";
-            exit(1);
-        }
+        return static_cast<uint32_t>(scopeStarts.size());
+    }
 
-        if (symbolTable.hasSymbol(idToken.value))
+    // id must not be declared in the innermost scope already; the checks
+    // report a redeclaration instead of adding it.
+    void addSymbol(uint32_t id, string_view name, string_view type)
+    {
+        if (id >= visible.size())
         {
-            cerr << "Error: Variable '" << idToken.value << "' already declared.\n";
-            exit(1);
+            visible.resize(id + 1, NO_ENTRY);
+            declarations.resize(id + 1, 0);
         }
-
-        symbolTable.addSymbol(idToken.value, typeToken.value);
-        if (tokens[pos].type == T_ASSIGN)
+        uint32_t version = declarations[id]++;
+        redeclarations += version > 0;
+        uint32_t index = static_cast<uint32_t>(entries.size());
+        entries.push_back(Entry{Symbol(name, type), id, visible[id], depth(), version, false});
+        visible[id] = index;
+        if (depth() > 0)
         {
-            pos++; // Consume '='
-            string value = parseExpression();
-            checkUndeclaredVariable(value);
-            tacGen.generateAssign(idToken.value, value);
+            undoLog.push_back(index);
         }
-
-        if (tokens[pos].type != T_SEMICOLON)
+    }
+    // True if a declaration of id is in scope, here or in an outer scope.
+    bool hasSymbol(uint32_t id)
+    {
+        return id < visible.size() && visible[id] != NO_ENTRY;
+    }
+    // The entry id resolves to in the current scope, or NO_ENTRY.
+    uint32_t lookup(uint32_t id) const
+    {
+        return id < visible.size() ? visible[id] : NO_ENTRY;
+    }
+    // The name an entry is listed and lowered under. The name.N names are
+    // only built once asked for.
+    string_view nameOf(uint32_t index)
+    {
+        Entry &entry = entries[index];
+        if (entry.version > 0 && !entry.renamed)
         {
-            cerr << "Syntax error: Expected ';' after declaration.\n";
-            exit(1);
+            versionedNames.push_back(string(entry.symbol.name) + "." + to_string(entry.version));
+            entry.symbol.name = versionedNames.back();
+            entry.renamed = true;
         }
-
-        expect(T_SEMICOLON);
+        return entry.symbol.name;
+    }
+    // True if id is declared in the innermost open scope itself.
+    bool declaredInScope(uint32_t id)
+    {
+        return hasSymbol(id) && entries[visible[id]].depth == depth();
     }
-    void checkUndeclaredVariable(const string &expr)
+    string_view getVariableType(uint32_t id)
     {
-        // If the expression is a variable (ID), check if it is declared
-        if (isVariable(expr) && !symbolTable.hasSymbol(expr))
+        if (!hasSymbol(id))
         {
-            cerr << "Error: Variable '" << expr << "' used but not declared.\n";
-            exit(1);
+            throw runtime_error("Semantic error: Variable with symbol id " + to_string(id) + " is not declared.");
         }
+        return entries[visible[id]].symbol.type;
     }
 
-    // Helper function to check if a string is a variable (ID)
-    bool isVariable(const string &str)
+    void display(ostream &out)
     {
-        return isalpha(str[0]) || str[0] == '_'; // Variable names typically start with a letter or underscore
+        out << "\nSymbol Table:\n";
+        out << "Name\tType\n";
+        for (uint32_t i = 0; i < entries.size(); i++)
+        {
+            out << nameOf(i) << "\t" << entries[i].symbol.type << "\t"
+                 << endl;
+        }
     }
+};
 
-    void parseAssignment()
+// An operand of a three-address instruction: a virtual register (printed
+// t<id>), a variable, a numeric constant with its decoded value, or a
+// bool/string literal. A variable carries its interned symbol id, and the
+// SymbolTable entry of the declaration it names when that is known (NO_ENTRY
+// otherwise), so that a variable and one it shadows stay apart. text is the
+// variable name, or the constant as written.
+struct TACOperand
+{
+    enum Kind : uint8_t
     {
-        string varName = tokens[pos++].value;
+        TEMP,
+        SYMBOL,
+        INT_CONSTANT,
+        FLOAT_CONSTANT,
+        LITERAL
+    };
 
-        if (!symbolTable.hasSymbol(varName))
-        {
-            cerr << "Error: Variable '" << varName << "' not declared.\n";
-            exit(1);
-        }
-
-        expect(T_ASSIGN);
+    Kind kind;
+    uint32_t id;
+    uint32_t entry;
+    NumericLiteral value;
+    string_view text;
 
-        string value = parseExpression();
-        string varType = symbolTable.getVariableType(varName);
+    static TACOperand temp(uint32_t id)
+    {
+        return TACOperand{TEMP, id, SymbolTable::NO_ENTRY, NumericLiteral{0}, string_view()};
+    }
 
-        if (!isCompatibleType(varType, value))
-        {
-            cerr << "Type error: Cannot assign value '" << value
-                 << "' to variable of type '" << varType
-                 << "'\n";
-            exit(1);
-        }
+    static TACOperand symbol(uint32_t id, string_view name, uint32_t entry = SymbolTable::NO_ENTRY)
+    {
+        return TACOperand{SYMBOL, id, entry, NumericLiteral{0}, name};
+    }
 
-        tacGen.generateAssign(varName, value);
-        expect(T_SEMICOLON);
+    static TACOperand literal(string_view text)
+    {
+        return TACOperand{LITERAL, NO_SYMBOL, SymbolTable::NO_ENTRY, NumericLiteral{0}, text};
     }
 
-    bool isCompatibleType(const string &varType, const string &value)
+    static TACOperand constant(Kind kind, NumericLiteral value, string_view text)
     {
-        if (!value.empty() && value[0] == 't')
-            return true;
-        if (varType == "int" && isInteger(value))
-            return true;
-        if (varType == "float" && (isInteger(value) || isFloat(value)))
-            return true;
-        if (varType == "bool" && (value == "true" || value == "false"))
+        return TACOperand{kind, NO_SYMBOL, SymbolTable::NO_ENTRY, value, text};
+    }
+};
+
+ostream &operator<<(ostream &out, const TACOperand &operand)
+{
+    if (operand.kind == TACOperand::TEMP)
+    {
+        return out << 't' << operand.id;
+    }
+    return out << operand.text;
+}
+
+struct TACInstruction
+{
+    enum Opcode : uint8_t
+    {
+        ASSIGN,  // result = arg1
+        BINARY,  // result = arg1 op arg2
+        IF_GOTO  // if arg1 goto L<label>
+    };
+
+    Opcode opcode;
+    string_view op;
+    TACOperand result;
+    TACOperand arg1;
+    TACOperand arg2;
+    uint32_t label;
+};
+
+class TACGenerator
+{
+public:
+    void generate(string_view op, const TACOperand &arg1, const TACOperand &arg2, const TACOperand &result)
+    {
+        tac.push_back(TACInstruction{TACInstruction::BINARY, op, result, arg1, arg2, 0});
+    }
+
+    void generateAssign(const TACOperand &var, const TACOperand &value)
+    {
+        tac.push_back(TACInstruction{TACInstruction::ASSIGN, string_view(), var, value, value, 0});
+    }
+
+    void printTAC(ostream &out)
+    {
+        out << "Three Address Code:" << endl;
+        for (const TACInstruction &instruction : tac)
+        {
+            switch (instruction.opcode)
+            {
+            case TACInstruction::ASSIGN:
+                out << instruction.result << " = " << instruction.arg1 << endl;
+                break;
+            case TACInstruction::BINARY:
+                out << instruction.result << " = " << instruction.arg1 << " " << instruction.op << " " << instruction.arg2 << endl;
+                break;
+            case TACInstruction::IF_GOTO:
+                out << "if " << instruction.arg1 << " goto L" << instruction.label << endl;
+                break;
+            }
+        }
+    }
+
+    uint32_t generateLabel()
+    {
+        return labelCount++;
+    }
+
+    TACOperand newTemp()
+    {
+        return TACOperand::temp(tempCount++);
+    }
+
+    // Appends code generated separately into fragment, renumbering its
+    // temporaries and labels to follow this generator's own.
+    void append(const TACGenerator &fragment)
+    {
+        for (TACInstruction instruction : fragment.tac)
+        {
+            rebaseTemp(instruction.result);
+            rebaseTemp(instruction.arg1);
+            rebaseTemp(instruction.arg2);
+            if (instruction.opcode == TACInstruction::IF_GOTO)
+            {
+                instruction.label += labelCount;
+            }
+            tac.push_back(instruction);
+        }
+        tempCount += fragment.tempCount;
+        labelCount += fragment.labelCount;
+    }
+
+    void generateIfGoto(const TACOperand &condition, uint32_t label)
+    {
+        tac.push_back(TACInstruction{TACInstruction::IF_GOTO, string_view(), condition, condition, condition, label});
+    }
+
+    void generateAssembly(ostream &out)
+    {
+        out << "\nGenerated Assembly Code:" << endl;
+        for (const TACInstruction &instruction : tac)
+        {
+            translateToAssembly(out, instruction);
+        }
+    }
+
+    vector<TACInstruction> tac;
+
+private:
+    uint32_t labelCount = 0;
+    uint32_t tempCount = 0;
+
+    void rebaseTemp(TACOperand &operand) const
+    {
+        if (operand.kind == TACOperand::TEMP)
+        {
+            operand.id += tempCount;
+        }
+    }
+
+    void translateToAssembly(ostream &out, const TACInstruction &instruction)
+    {
+        if (instruction.opcode == TACInstruction::IF_GOTO)
+        {
+            out << "CMP " << instruction.arg1 << ", 0" << endl;
+            out << "JNE L" << instruction.label << endl;
+            return;
+        }
+        string_view op = instruction.op;
+        if (instruction.opcode == TACInstruction::BINARY && (op == "+" || op == "-" || op == "*" || op == "/"))
+        {
+            out << "MOV AX, " << instruction.arg1 << endl;
+            if (op == "+")
+                out << "ADD AX, " << instruction.arg2 << endl;
+            else if (op == "-")
+                out << "SUB AX, " << instruction.arg2 << endl;
+            else if (op == "*")
+                out << "MUL " << instruction.arg2 << endl;
+            else if (op == "/")
+                out << "DIV " << instruction.arg2 << endl;
+            out << "MOV " << instruction.result << ", AX" << endl;
+        }
+        else if (instruction.opcode == TACInstruction::BINARY)
+        {
+            // Comparisons have no instruction selection yet and are listed
+            // as written
+            out << "MOV " << instruction.result << ", " << instruction.arg1 << " " << op << " " << instruction.arg2 << endl;
+        }
+        else
+        {
+            out << "MOV " << instruction.result << ", " << instruction.arg1 << endl;
+        }
+    }
+};
+
+// Keywords are classified with a perfect hash over the first byte, last byte
+// and length of the word. The multiplier is searched for at compile time, so
+// adding a keyword to a dialect either still yields a collision-free table
+// or fails the static_assert in KeywordTable.
+struct Keyword
+{
+    string_view text;
+    TokenTypeValue type;
+};
+
+// A dialect is the surface language the front end reads: its keyword
+// spellings, the statements it has besides declarations, assignments and
+// blocks (by the token that starts them), and the binary operators it
+// accepts. All of it is constexpr data; the Lexer and Parser are templates
+// on the dialect, so each gets its own keyword hash and dispatch tables and
+// nothing is configured at run time.
+struct EnglishDialect
+{
+    static constexpr const char *NAME = "english";
+
+    static constexpr Keyword KEYWORDS[] = {
+        {"int", T_INT},
+        {"float", T_FLOAT},
+        {"bool", T_BOOL},
+        {"true", T_BOOL_LITERAL},
+        {"false", T_BOOL_LITERAL},
+        {"if", T_IF},
+        {"string", T_STRING},
+        {"else", T_ELSE},
+        {"for", T_FOR},
+        {"while", T_WHILE},
+        {"do", T_DO},
+        {"return", T_RETURN},
+    };
+
+    static constexpr TokenTypeValue STATEMENTS[] = {T_IF, T_WHILE, T_FOR, T_DO, T_RETURN};
+
+    static constexpr TokenTypeValue OPERATORS[] = {T_OR, T_AND, T_EQ, T_NEQ, T_LT, T_GT, T_LE, T_GE,
+                                                   T_PLUS, T_MINUS, T_MUL, T_DIV};
+};
+
+// The Urdu-keyword dialect: "agar" for if and "wapis" for return, with the
+// statements and operators the Urdu parsers have always supported.
+struct UrduDialect
+{
+    static constexpr const char *NAME = "urdu";
+
+    static constexpr Keyword KEYWORDS[] = {
+        {"int", T_INT},
+        {"float", T_FLOAT},
+        {"bool", T_BOOL},
+        {"true", T_BOOL_LITERAL},
+        {"false", T_BOOL_LITERAL},
+        {"agar", T_IF},
+        {"string", T_STRING},
+        {"else", T_ELSE},
+        {"for", T_FOR},
+        {"while", T_WHILE},
+        {"wapis", T_RETURN},
+    };
+
+    static constexpr TokenTypeValue STATEMENTS[] = {T_IF, T_WHILE, T_FOR, T_RETURN};
+
+    static constexpr TokenTypeValue OPERATORS[] = {T_AND, T_EQ, T_NEQ, T_GT, T_PLUS, T_MINUS, T_MUL, T_DIV};
+};
+
+template <size_t N>
+constexpr bool containsToken(const TokenTypeValue (&types)[N], TokenTypeValue type)
+{
+    for (TokenTypeValue t : types)
+    {
+        if (t == type)
             return true;
-        if (varType == "string" && isStringLiteral(value))
+    }
+    return false;
+}
+
+constexpr size_t keywordHash(string_view word, size_t multiplier, size_t tableSize)
+{
+    return (static_cast<unsigned char>(word.front()) +
+            static_cast<unsigned char>(word.back()) * multiplier + word.size()) &
+           (tableSize - 1);
+}
+
+// The smallest power-of-two table, from 16 slots, and the first multiplier
+// for it that give Dialect's keywords one slot each; {0, 0} if none does.
+struct KeywordHash
+{
+    size_t tableSize;
+    size_t multiplier;
+};
+
+constexpr size_t MAX_KEYWORD_TABLE_SIZE = 256;
+
+template <typename Dialect>
+constexpr KeywordHash findKeywordHash()
+{
+    for (size_t tableSize = 16; tableSize <= MAX_KEYWORD_TABLE_SIZE; tableSize *= 2)
+    {
+        for (size_t multiplier = 1; multiplier < 256; multiplier++)
+        {
+            bool used[MAX_KEYWORD_TABLE_SIZE] = {};
+            bool collision = false;
+            for (const Keyword &keyword : Dialect::KEYWORDS)
+            {
+                size_t slot = keywordHash(keyword.text, multiplier, tableSize);
+                if (used[slot])
+                {
+                    collision = true;
+                    break;
+                }
+                used[slot] = true;
+            }
+            if (!collision)
+            {
+                return KeywordHash{tableSize, multiplier};
+            }
+        }
+    }
+    return KeywordHash{0, 0};
+}
+
+template <typename Dialect>
+struct KeywordTable
+{
+    static constexpr KeywordHash HASH = findKeywordHash<Dialect>();
+    static_assert(HASH.tableSize != 0, "no perfect hash found for the keyword set");
+
+    Keyword slots[HASH.tableSize];
+
+    constexpr KeywordTable() : slots()
+    {
+        for (Keyword &slot : slots)
+        {
+            slot = Keyword{"", T_ID};
+        }
+        for (const Keyword &keyword : Dialect::KEYWORDS)
+        {
+            slots[keywordHash(keyword.text, HASH.multiplier, HASH.tableSize)] = keyword;
+        }
+    }
+};
+
+template <typename Dialect>
+constexpr KeywordTable<Dialect> KEYWORD_TABLE;
+
+// Returns the keyword token type for word, or T_ID. word must not be empty.
+template <typename Dialect = EnglishDialect>
+inline TokenTypeValue classifyWord(string_view word)
+{
+    constexpr KeywordHash hash = KeywordTable<Dialect>::HASH;
+    const Keyword &slot = KEYWORD_TABLE<Dialect>.slots[keywordHash(word, hash.multiplier, hash.tableSize)];
+    return slot.text == word ? slot.type : T_ID;
+}
+
+// Scanning kernels for the Lexer's long runs: whitespace, the end of a line
+// comment, the "*/" of a block comment and the closing quote of a string
+// literal. Each kernel returns a pointer to the first byte that stops the
+// scan, or end. The SSE2 and AVX2 variants test 16/32 bytes per step and
+// finish the tail with the scalar loop; activeScan is picked once at startup
+// from the running CPU.
+const char *skipSpaceScalar(const char *p, const char *end)
+{
+    while (p < end && isspace(static_cast<unsigned char>(*p)))
+        p++;
+    return p;
+}
+
+const char *findByteScalar(const char *p, const char *end, char target)
+{
+    while (p < end && *p != target)
+        p++;
+    return p;
+}
+
+const char *findCommentEndScalar(const char *p, const char *end)
+{
+    while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+        p++;
+    return p + 1 < end ? p : end;
+}
+
+#if defined(__x86_64__)
+const char *skipSpaceSse2(const char *p, const char *end)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // '\t'..'\r' are the bytes whose distance from '\t' is at most 4
+        __m128i fromTab = _mm_sub_epi8(chunk, tab);
+        __m128i isControlSpace = _mm_cmpeq_epi8(_mm_min_epu8(fromTab, four), fromTab);
+        uint32_t spaceMask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), isControlSpace));
+        if (spaceMask != 0xFFFF)
+            return p + __builtin_ctz(~spaceMask);
+        p += 16;
+    }
+    return skipSpaceScalar(p, end);
+}
+
+const char *findByteSse2(const char *p, const char *end, char target)
+{
+    const __m128i wanted = _mm_set1_epi8(target);
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        uint32_t targetMask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+        if (targetMask != 0)
+            return p + __builtin_ctz(targetMask);
+        p += 16;
+    }
+    return findByteScalar(p, end, target);
+}
+
+const char *findCommentEndSse2(const char *p, const char *end)
+{
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    while (end - p >= 17)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        uint32_t closeMask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(chunk, star), _mm_cmpeq_epi8(next, slash)));
+        if (closeMask != 0)
+            return p + __builtin_ctz(closeMask);
+        p += 16;
+    }
+    return findCommentEndScalar(p, end);
+}
+
+__attribute__((target("avx2"))) const char *skipSpaceAvx2(const char *p, const char *end)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    while (end - p >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i fromTab = _mm256_sub_epi8(chunk, tab);
+        __m256i isControlSpace = _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, four), fromTab);
+        uint32_t spaceMask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), isControlSpace));
+        if (spaceMask != 0xFFFFFFFFu)
+            return p + __builtin_ctz(~spaceMask);
+        p += 32;
+    }
+    return skipSpaceSse2(p, end);
+}
+
+__attribute__((target("avx2"))) const char *findByteAvx2(const char *p, const char *end, char target)
+{
+    const __m256i wanted = _mm256_set1_epi8(target);
+    while (end - p >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        uint32_t targetMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));
+        if (targetMask != 0)
+            return p + __builtin_ctz(targetMask);
+        p += 32;
+    }
+    return findByteSse2(p, end, target);
+}
+
+__attribute__((target("avx2"))) const char *findCommentEndAvx2(const char *p, const char *end)
+{
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    while (end - p >= 33)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+        uint32_t closeMask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(chunk, star), _mm256_cmpeq_epi8(next, slash)));
+        if (closeMask != 0)
+            return p + __builtin_ctz(closeMask);
+        p += 32;
+    }
+    return findCommentEndSse2(p, end);
+}
+#endif
+
+struct ScanKernels
+{
+    const char *name;
+    const char *(*skipSpace)(const char *p, const char *end);
+    const char *(*findByte)(const char *p, const char *end, char target);
+    const char *(*findCommentEnd)(const char *p, const char *end);
+};
+
+const ScanKernels SCALAR_SCAN = {"scalar", skipSpaceScalar, findByteScalar, findCommentEndScalar};
+#if defined(__x86_64__)
+const ScanKernels SSE2_SCAN = {"sse2", skipSpaceSse2, findByteSse2, findCommentEndSse2};
+const ScanKernels AVX2_SCAN = {"avx2", skipSpaceAvx2, findByteAvx2, findCommentEndAvx2};
+#endif
+
+const ScanKernels *selectScanKernels()
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &AVX2_SCAN;
+    return &SSE2_SCAN;
+#else
+    return &SCALAR_SCAN;
+#endif
+}
+
+const ScanKernels *activeScan = selectScanKernels();
+
+// The Lexer is a table-driven DFA. CHAR_CLASS folds every byte into a small
+// set of classes and LEX_TRANSITIONS[state][class] gives the next state. The
+// DFA starts in S_START at each token and walks bytes until it reaches an
+// accepting state; LEX_ACCEPTS then says which token (or skip action) was
+// recognised and whether the byte that ended it belongs to it. Two-character
+// operators are handled by the S_EQUALS/S_BANG/S_LESS/S_GREATER/S_AMP/S_PIPE/S_SLASH
+// lookahead states. Both tables are built at compile time.
+enum CharClass : uint8_t
+{
+    C_OTHER,
+    C_SPACE,
+    C_LETTER,
+    C_DIGIT,
+    C_DOT,
+    C_QUOTE,
+    C_SLASH,
+    C_STAR,
+    C_EQUALS,
+    C_BANG,
+    C_LESS,
+    C_GREATER,
+    C_AMP,
+    C_PIPE,
+    C_PLUS,
+    C_MINUS,
+    C_LPAREN,
+    C_RPAREN,
+    C_LBRACE,
+    C_RBRACE,
+    C_SEMICOLON,
+    C_END, // past the last byte of the source
+    CHAR_CLASS_COUNT
+};
+
+enum LexState : uint8_t
+{
+    S_START,
+    S_IDENT,
+    S_NUMBER,
+    S_EQUALS,
+    S_BANG,
+    S_LESS,
+    S_GREATER,
+    S_AMP,
+    S_PIPE,
+    S_SLASH,
+    LEX_STATE_COUNT
+};
+
+enum LexAction : uint8_t
+{
+    ACT_EMIT,
+    ACT_EMIT_WORD,
+    ACT_EMIT_NUMBER,
+    ACT_SKIP_SPACE,
+    ACT_LINE_COMMENT,
+    ACT_BLOCK_COMMENT,
+    ACT_STRING,
+    ACT_FINISH,
+    ACT_ERROR
+};
+
+struct LexAccept
+{
+    TokenTypeValue type;
+    LexAction action;
+    bool consumesCurrent;
+};
+
+// Accepting states are numbered from LEX_STATE_COUNT upwards.
+enum LexAcceptId : uint8_t
+{
+    A_IDENT,
+    A_NUMBER,
+    A_ASSIGN,
+    A_EQ,
+    A_NEQ,
+    A_LT,
+    A_LE,
+    A_GT,
+    A_GE,
+    A_AND,
+    A_OR,
+    A_DIV,
+    A_PLUS,
+    A_MINUS,
+    A_MUL,
+    A_LPAREN,
+    A_RPAREN,
+    A_LBRACE,
+    A_RBRACE,
+    A_SEMICOLON,
+    A_SPACE,
+    A_LINE_COMMENT,
+    A_BLOCK_COMMENT,
+    A_STRING,
+    A_END,
+    A_ERROR,
+    LEX_ACCEPT_COUNT
+};
+
+constexpr LexAccept LEX_ACCEPTS[LEX_ACCEPT_COUNT] = {
+    {T_ID, ACT_EMIT_WORD, false},
+    {T_NUM, ACT_EMIT_NUMBER, false},
+    {T_ASSIGN, ACT_EMIT, false},
+    {T_EQ, ACT_EMIT, true},
+    {T_NEQ, ACT_EMIT, true},
+    {T_LT, ACT_EMIT, false},
+    {T_LE, ACT_EMIT, true},
+    {T_GT, ACT_EMIT, false},
+    {T_GE, ACT_EMIT, true},
+    {T_AND, ACT_EMIT, true},
+    {T_OR, ACT_EMIT, true},
+    {T_DIV, ACT_EMIT, false},
+    {T_PLUS, ACT_EMIT, true},
+    {T_MINUS, ACT_EMIT, true},
+    {T_MUL, ACT_EMIT, true},
+    {T_LPAREN, ACT_EMIT, true},
+    {T_RPAREN, ACT_EMIT, true},
+    {T_LBRACE, ACT_EMIT, true},
+    {T_RBRACE, ACT_EMIT, true},
+    {T_SEMICOLON, ACT_EMIT, true},
+    {T_EOF, ACT_SKIP_SPACE, false},
+    {T_EOF, ACT_LINE_COMMENT, true},
+    {T_EOF, ACT_BLOCK_COMMENT, true},
+    {T_STRING_LITERAL, ACT_STRING, false},
+    {T_EOF, ACT_FINISH, false},
+    {T_EOF, ACT_ERROR, false},
+};
+
+struct CharClassTable
+{
+    CharClass classes[256];
+
+    constexpr CharClassTable() : classes()
+    {
+        for (CharClass &cls : classes)
+        {
+            cls = C_OTHER;
+        }
+        for (int c = 'a'; c <= 'z'; c++)
+        {
+            classes[c] = C_LETTER;
+            classes[c - 'a' + 'A'] = C_LETTER;
+        }
+        for (int c = '0'; c <= '9'; c++)
+        {
+            classes[c] = C_DIGIT;
+        }
+        for (unsigned char c : string_view(" \t\n\v\f\r"))
+        {
+            classes[c] = C_SPACE;
+        }
+        classes['.'] = C_DOT;
+        classes['"'] = C_QUOTE;
+        classes['/'] = C_SLASH;
+        classes['*'] = C_STAR;
+        classes['='] = C_EQUALS;
+        classes['!'] = C_BANG;
+        classes['<'] = C_LESS;
+        classes['>'] = C_GREATER;
+        classes['&'] = C_AMP;
+        classes['|'] = C_PIPE;
+        classes['+'] = C_PLUS;
+        classes['-'] = C_MINUS;
+        classes['('] = C_LPAREN;
+        classes[')'] = C_RPAREN;
+        classes['{'] = C_LBRACE;
+        classes['}'] = C_RBRACE;
+        classes[';'] = C_SEMICOLON;
+    }
+};
+
+struct LexTransitionTable
+{
+    uint8_t next[LEX_STATE_COUNT][CHAR_CLASS_COUNT];
+
+    static constexpr uint8_t accept(LexAcceptId id)
+    {
+        return static_cast<uint8_t>(LEX_STATE_COUNT) + static_cast<uint8_t>(id);
+    }
+
+    constexpr void fill(LexState state, LexAcceptId id)
+    {
+        for (uint8_t &entry : next[state])
+        {
+            entry = accept(id);
+        }
+    }
+
+    constexpr LexTransitionTable() : next()
+    {
+        fill(S_START, A_ERROR);
+        next[S_START][C_SPACE] = accept(A_SPACE);
+        next[S_START][C_LETTER] = S_IDENT;
+        next[S_START][C_DIGIT] = S_NUMBER;
+        next[S_START][C_QUOTE] = accept(A_STRING);
+        next[S_START][C_SLASH] = S_SLASH;
+        next[S_START][C_STAR] = accept(A_MUL);
+        next[S_START][C_EQUALS] = S_EQUALS;
+        next[S_START][C_BANG] = S_BANG;
+        next[S_START][C_LESS] = S_LESS;
+        next[S_START][C_GREATER] = S_GREATER;
+        next[S_START][C_AMP] = S_AMP;
+        next[S_START][C_PIPE] = S_PIPE;
+        next[S_START][C_PLUS] = accept(A_PLUS);
+        next[S_START][C_MINUS] = accept(A_MINUS);
+        next[S_START][C_LPAREN] = accept(A_LPAREN);
+        next[S_START][C_RPAREN] = accept(A_RPAREN);
+        next[S_START][C_LBRACE] = accept(A_LBRACE);
+        next[S_START][C_RBRACE] = accept(A_RBRACE);
+        next[S_START][C_SEMICOLON] = accept(A_SEMICOLON);
+        next[S_START][C_END] = accept(A_END);
+
+        fill(S_IDENT, A_IDENT);
+        next[S_IDENT][C_LETTER] = S_IDENT;
+        next[S_IDENT][C_DIGIT] = S_IDENT;
+
+        fill(S_NUMBER, A_NUMBER);
+        next[S_NUMBER][C_DIGIT] = S_NUMBER;
+        next[S_NUMBER][C_DOT] = S_NUMBER;
+
+        fill(S_EQUALS, A_ASSIGN);
+        next[S_EQUALS][C_EQUALS] = accept(A_EQ);
+
+        fill(S_BANG, A_ERROR);
+        next[S_BANG][C_EQUALS] = accept(A_NEQ);
+
+        fill(S_LESS, A_LT);
+        next[S_LESS][C_EQUALS] = accept(A_LE);
+
+        fill(S_GREATER, A_GT);
+        next[S_GREATER][C_EQUALS] = accept(A_GE);
+
+        fill(S_AMP, A_ERROR);
+        next[S_AMP][C_AMP] = accept(A_AND);
+
+        fill(S_PIPE, A_ERROR);
+        next[S_PIPE][C_PIPE] = accept(A_OR);
+
+        fill(S_SLASH, A_DIV);
+        next[S_SLASH][C_SLASH] = accept(A_LINE_COMMENT);
+        next[S_SLASH][C_STAR] = accept(A_BLOCK_COMMENT);
+    }
+};
+
+constexpr CharClassTable CHAR_CLASS;
+constexpr LexTransitionTable LEX_TRANSITIONS;
+
+// Maps byte offsets in a source to zero-based line and column numbers, the
+// numbering the diagnostics have always used. Tokens only carry their
+// position in the source, so nothing counts lines while lexing; the table of
+// line start offsets is built with the newline scan kernel the first time a
+// diagnostic asks, and each lookup is a binary search.
+class LineIndex
+{
+public:
+    struct Position
+    {
+        size_t line;
+        size_t column;
+    };
+
+    LineIndex(string_view src) : src(src) {}
+
+    Position locate(size_t offset)
+    {
+        if (lineStarts.empty())
+        {
+            build();
+        }
+        size_t line = upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin() - 1;
+        return Position{line, offset - lineStarts[line]};
+    }
+
+    Position locate(const char *at)
+    {
+        return locate(at - src.data());
+    }
+
+private:
+    string_view src;
+    vector<size_t> lineStarts;
+
+    void build()
+    {
+        const char *end = src.data() + src.size();
+        lineStarts.push_back(0);
+        for (const char *p = activeScan->findByte(src.data(), end, '\n'); p < end;
+             p = activeScan->findByte(p + 1, end, '\n'))
+        {
+            lineStarts.push_back(p + 1 - src.data());
+        }
+    }
+};
+
+// Lexes the keywords of Dialect; Lexer is the English one.
+template <typename Dialect>
+class BasicLexer
+{
+private:
+    string_view src;
+    size_t pos;
+    StringPool &pool;
+
+    const char *end() const
+    {
+        return src.data() + src.size();
+    }
+
+    CharClass classAt(size_t offset) const
+    {
+        return offset < src.size() ? CHAR_CLASS.classes[static_cast<unsigned char>(src[offset])] : C_END;
+    }
+
+public:
+    // The Lexer does not copy the source; the caller keeps it alive.
+    // Identifiers are interned into pool. Lexing starts at offset start,
+    // which must be in plain code (not inside a token, comment or string).
+    BasicLexer(string_view src, StringPool &pool, size_t start = 0) : pool(pool)
+    {
+        this->src = src;
+        this->pos = start;
+    }
+
+    vector<Token> tokenize()
+    {
+        vector<Token> tokens;
+        do
+        {
+            tokens.push_back(next());
+        } while (tokens.back().type != T_EOF);
+        return tokens;
+    }
+
+    // A source too large for a TokenStore lexes to a single T_ERROR token,
+    // with an empty view, and T_EOF.
+    TokenStore tokenizeCompact()
+    {
+        TokenStore store(src);
+        if (!TokenStore::fits(src))
+        {
+            store.push(Token{T_ERROR, NO_SYMBOL, src.substr(0, 0)});
+            store.push(Token{T_EOF, NO_SYMBOL, src.substr(0, 0)});
+            return store;
+        }
+        tokenizeInto(store);
+        return store;
+    }
+
+    // Appends every remaining token, up to and including T_EOF, to store.
+    // store must be over a buffer that contains this Lexer's source.
+    void tokenizeInto(TokenStore &store)
+    {
+        Token token;
+        do
+        {
+            token = next();
+            store.push(token);
+        } while (token.type != T_EOF);
+    }
+
+    // Lexes and returns the next token. Once the source is exhausted every
+    // call returns T_EOF.
+    Token next()
+    {
+        while (true)
+        {
+            size_t start = pos;
+            uint8_t state = S_START;
+            while ((state = LEX_TRANSITIONS.next[state][classAt(pos)]) < LEX_STATE_COUNT)
+            {
+                pos++;
+            }
+            const LexAccept &accept = LEX_ACCEPTS[state - LEX_STATE_COUNT];
+            pos += accept.consumesCurrent;
+
+            switch (accept.action)
+            {
+            case ACT_EMIT:
+                return Token{accept.type, NO_SYMBOL, src.substr(start, pos - start)};
+            case ACT_EMIT_WORD:
+            {
+                string_view word = src.substr(start, pos - start);
+                TokenTypeValue type = classifyWord<Dialect>(word);
+                return Token{type, type == T_ID ? pool.intern(word) : NO_SYMBOL, word};
+            }
+            case ACT_EMIT_NUMBER:
+                return decodeNumber(src.substr(start, pos - start));
+            case ACT_SKIP_SPACE:
+                // Most runs are a single blank between tokens; only longer
+                // runs are worth a call into the scan kernels
+                if (src[start] == ' ' && classAt(start + 1) != C_SPACE)
+                {
+                    pos = start + 1;
+                    break;
+                }
+                pos = activeScan->skipSpace(src.data() + start, end()) - src.data();
+                break;
+            case ACT_LINE_COMMENT:
+                pos = activeScan->findByte(src.data() + pos, end(), '\n') - src.data();
+                if (pos < src.size())
+                {
+                    pos++;
+                }
+                break;
+            case ACT_BLOCK_COMMENT:
+            {
+                const char *close = activeScan->findCommentEnd(src.data() + pos, end());
+                pos = close == end() ? src.size() : close - src.data() + 2;
+                break;
+            }
+            case ACT_STRING:
+                return consumeString();
+            case ACT_FINISH:
+                return Token{T_EOF, NO_SYMBOL, src.substr(src.size(), 0)};
+            case ACT_ERROR:
+                pos = start + 1;
+                return Token{T_ERROR, NO_SYMBOL, src.substr(start, 1)};
+            }
+        }
+    }
+
+    // Describes the lexical error a T_ERROR token stands for. The token's
+    // text is all the Lexer keeps, so the kind of error is worked out again
+    // from it.
+    static string describeError(string_view text)
+    {
+        if (text.empty())
+        {
+            return "Error: source files larger than 4 GB are not supported";
+        }
+        if (text.front() == '"')
+        {
+            return "Error: Unterminated string literal";
+        }
+        if (CHAR_CLASS.classes[static_cast<unsigned char>(text.front())] == C_DIGIT || text.front() == '.')
+        {
+            NumericLiteral value;
+            bool outOfRange = false;
+            decodeNumber(text, value, &outOfRange);
+            if (outOfRange)
+            {
+                return "Error: Numeric literal '" + string(text) + "' is out of range";
+            }
+            return "Error: Malformed numeric literal '" + string(text) + "'";
+        }
+        return "Unexpected character '" + string(text) + "'";
+    }
+
+private:
+    // The DFA accepts any run of digits and dots as a number; a run with one
+    // dot is a float literal and a run without is an integer. The value is
+    // decoded here, once, and the Parser never looks at the digits again.
+    // A run that is not a valid number becomes a T_ERROR token.
+    Token decodeNumber(string_view text)
+    {
+        Token token{count(text.begin(), text.end(), '.') == 0 ? T_NUM : T_FLOAT_LITERAL, NO_SYMBOL, text};
+        if (!decodeNumber(text, token.literal))
+        {
+            token.type = T_ERROR;
+        }
+        return token;
+    }
+
+    // False if text is malformed or, setting *outOfRange, too large.
+    static bool decodeNumber(string_view text, NumericLiteral &value, bool *outOfRange = nullptr)
+    {
+        const char *first = text.data();
+        const char *last = first + text.size();
+        size_t dots = count(first, last, '.');
+        from_chars_result decoded{};
+        if (dots == 0)
+        {
+            decoded = from_chars(first, last, value.intValue);
+        }
+        else if (dots == 1)
+        {
+            decoded = from_chars(first, last, value.floatValue, chars_format::fixed);
+        }
+        if (dots > 1 || decoded.ptr != last)
+        {
+            return false;
+        }
+        if (decoded.ec == errc::result_out_of_range)
+        {
+            if (outOfRange != nullptr)
+                *outOfRange = true;
+            return false;
+        }
+        return true;
+    }
+
+    // An unterminated string runs to the end of the source and is returned
+    // as a T_ERROR token.
+    Token consumeString()
+    {
+        size_t start = pos;
+        pos = activeScan->findByte(src.data() + pos + 1, end(), '"') - src.data();
+        if (pos >= src.size())
+        {
+            return Token{T_ERROR, NO_SYMBOL, src.substr(start)};
+        }
+        pos++;
+        return Token{T_STRING_LITERAL, NO_SYMBOL, src.substr(start, pos - start)};
+    }
+};
+
+using Lexer = BasicLexer<EnglishDialect>;
+
+// Parallel lexing splits the source into chunks that each start at the
+// beginning of a line in plain code, so every chunk can be lexed on its own.
+// findChunkBoundaries finds those points with a quick pre-scan that only
+// tracks string literals and comments: outside them, '"' and "//" / "/*"
+// are the only bytes that change the lexer's mode, so the pre-scan jumps
+// from one to the next with the scan kernels instead of lexing tokens.
+vector<size_t> findChunkBoundaries(string_view src, size_t chunkCount)
+{
+    vector<size_t> bounds = {0};
+    const char *base = src.data();
+    const char *end = base + src.size();
+    const char *p = base; // always in plain code
+    const char *nextQuote = activeScan->findByte(base, end, '"');
+    const char *nextSlash = activeScan->findByte(base, end, '/');
+
+    for (size_t i = 1; i < chunkCount && p < end; i++)
+    {
+        const char *target = max(base + src.size() * i / chunkCount, base + bounds.back() + 1);
+        while (p < end)
+        {
+            if (nextQuote < p)
+                nextQuote = activeScan->findByte(p, end, '"');
+            if (nextSlash < p)
+                nextSlash = activeScan->findByte(p, end, '/');
+            // A '/' not followed by '/' or '*' is just a division
+            while (nextSlash < end && (nextSlash + 1 == end || (nextSlash[1] != '/' && nextSlash[1] != '*')))
+                nextSlash = activeScan->findByte(nextSlash + 1, end, '/');
+            const char *regionStart = min(nextQuote, nextSlash);
+
+            if (target < regionStart)
+            {
+                const char *newline = activeScan->findByte(target, regionStart, '\n');
+                if (newline < regionStart)
+                {
+                    bounds.push_back(newline + 1 - base);
+                    p = newline + 1;
+                    break;
+                }
+            }
+            if (regionStart >= end)
+            {
+                p = end;
+                break;
+            }
+
+            // Skip the string or comment; p lands back in plain code
+            if (*regionStart == '"')
+            {
+                const char *close = activeScan->findByte(regionStart + 1, end, '"');
+                p = close < end ? close + 1 : end;
+            }
+            else if (regionStart[1] == '/')
+            {
+                p = activeScan->findByte(regionStart, end, '\n');
+            }
+            else
+            {
+                const char *close = activeScan->findCommentEnd(regionStart + 2, end);
+                p = close < end ? close + 2 : end;
+            }
+            target = max(target, p);
+        }
+    }
+    if (bounds.back() != src.size())
+    {
+        bounds.push_back(src.size());
+    }
+    return bounds;
+}
+
+// Each chunk interns into its own pool; the pools are merged into the
+// caller's in chunk order afterwards, which hands out the same ids as
+// sequential lexing would.
+struct LexChunk
+{
+    string_view source;
+    TokenStore tokens;
+    StringPool pool;
+};
+
+template <typename Dialect>
+void *lexChunkThread(void *arg)
+{
+    LexChunk *chunk = (LexChunk *)arg;
+    BasicLexer<Dialect>(chunk->source, chunk->pool).tokenizeInto(chunk->tokens);
+    return NULL;
+}
+
+// Lexes src on up to threadCount threads and returns the same tokens as
+// Lexer(src, pool).tokenizeCompact(). Sources too small to give every thread
+// minChunkBytes are lexed on the calling thread.
+template <typename Dialect = EnglishDialect>
+TokenStore tokenizeParallel(string_view src, StringPool &pool, size_t threadCount, size_t minChunkBytes = 1 << 20)
+{
+    size_t chunkCount = min(threadCount, src.size() / max<size_t>(minChunkBytes, 1));
+    if (chunkCount <= 1 || !TokenStore::fits(src))
+    {
+        return BasicLexer<Dialect>(src, pool).tokenizeCompact();
+    }
+
+    vector<size_t> bounds = findChunkBoundaries(src, chunkCount);
+    vector<LexChunk> chunks(bounds.size() - 1);
+    vector<pthread_t> tids(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        // Chunk stores hold offsets into the whole source, so they can be
+        // concatenated as they are.
+        chunks[i].source = src.substr(bounds[i], bounds[i + 1] - bounds[i]);
+        chunks[i].tokens = TokenStore(src);
+        pthread_create(&tids[i], NULL, lexChunkThread<Dialect>, &chunks[i]);
+    }
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+
+    // Every chunk but the last ends with an EOF token that is dropped
+    size_t total = 1;
+    for (const LexChunk &chunk : chunks)
+    {
+        total += chunk.tokens.size() - 1;
+    }
+    TokenStore tokens(src);
+    tokens.reserve(total);
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        vector<uint32_t> remap(chunks[i].pool.size());
+        for (uint32_t id = 0; id < remap.size(); id++)
+        {
+            remap[id] = pool.intern(chunks[i].pool.name(id));
+        }
+        size_t count = chunks[i].tokens.size() - (i + 1 < chunks.size() ? 1 : 0);
+        tokens.append(chunks[i].tokens, count, remap);
+    }
+    return tokens;
+}
+
+// An edit to a source buffer, in the coordinates of the old buffer.
+struct SourceEdit
+{
+    size_t offset;
+    size_t removed;
+    string_view inserted;
+};
+
+// What relex() returns when it could not reuse any tokens.
+const size_t RELEXED_WHOLE_SOURCE = SIZE_MAX;
+
+// Relexes source, which is tokens.source() with edit applied, and updates
+// tokens in place. Only the damaged region is lexed again, and the
+// surrounding tokens are kept; what remains linear in the file size is one
+// memmove per column and the offset shift of the tokens after the edit.
+//
+// Tokens that end before the edit are kept: the lexer never looks more than
+// one byte past a token, and every token starts in plain code, so lexing
+// restarts at the end of the last kept token. Relexing then continues until
+// it produces a token past the inserted text that starts where an old token
+// started (shifted by the edit): from that point the bytes and the lexer
+// state both match, and the old tokens are kept from there on. An edit that
+// opens a comment or string keeps relexing until the old and new streams
+// meet again, or to the end of the source.
+//
+// Identifiers are interned into pool, which must be the pool tokens was
+// lexed with. Names already in pool may still view the old buffer, so it
+// must outlive pool.
+//
+// Returns the offset in source from which every token is an old one, moved
+// by the edit (source.size() if relexing ran to the end). If edit does not
+// match the two buffers, or source is too large for a TokenStore, the whole
+// source is lexed again and RELEXED_WHOLE_SOURCE is returned.
+template <typename Dialect = EnglishDialect>
+size_t relex(TokenStore &tokens, string_view source, const SourceEdit &edit, StringPool &pool)
+{
+    string_view old = tokens.source();
+    if (edit.offset > old.size() || edit.removed > old.size() - edit.offset ||
+        source.size() != old.size() - edit.removed + edit.inserted.size() || !TokenStore::fits(source))
+    {
+        tokens = BasicLexer<Dialect>(source, pool).tokenizeCompact();
+        return RELEXED_WHOLE_SOURCE;
+    }
+    ptrdiff_t shift = static_cast<ptrdiff_t>(edit.inserted.size()) - static_cast<ptrdiff_t>(edit.removed);
+
+    size_t kept = 0, hi = tokens.size();
+    while (kept < hi)
+    {
+        size_t mid = kept + (hi - kept) / 2;
+        if (tokens.end(mid) < edit.offset)
+            kept = mid + 1;
+        else
+            hi = mid;
+    }
+
+    vector<Token> relexed;
+    size_t damageEnd = edit.offset + edit.inserted.size();
+    size_t resume = kept;
+    size_t unchangedFrom = source.size();
+    BasicLexer<Dialect> lexer(source, pool, kept == 0 ? 0 : tokens.end(kept - 1));
+    while (true)
+    {
+        Token token = lexer.next();
+        size_t start = token.value.data() - source.data();
+        if (start >= damageEnd)
+        {
+            size_t oldStart = start - shift;
+            resume = tokens.lowerBound(oldStart, resume);
+            if (resume < tokens.size() && tokens.offset(resume) == oldStart)
+            {
+                unchangedFrom = start;
+                break;
+            }
+        }
+        relexed.push_back(token);
+        if (token.type == T_EOF)
+        {
+            resume = tokens.size();
+            break;
+        }
+    }
+    tokens.splice(source, kept, resume, relexed, shift);
+    return unchangedFrom;
+}
+
+// Bounded single-producer/single-consumer queue of token batches between a
+// lexer thread and a parser thread. The producer only writes slots in
+// [tail, head + CAPACITY) and the consumer only reads slots in [head, tail),
+// so the two indexes are the only shared state. A full ring stalls the lexer
+// and an empty one stalls the parser.
+class TokenRing
+{
+public:
+    static const size_t BATCH_SIZE = 256;
+    static const size_t CAPACITY = 64;
+
+    struct Batch
+    {
+        Token tokens[BATCH_SIZE];
+        size_t count;
+    };
+
+    TokenRing() : slots(CAPACITY) {}
+
+    // Producer: waits for a free slot and returns it for filling.
+    Batch &beginWrite()
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        wait([&]() { return t - head.load(memory_order_acquire) < CAPACITY; });
+        return slots[t % CAPACITY];
+    }
+
+    // Producer: publishes the slot returned by beginWrite().
+    void commitWrite()
+    {
+        tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    // Consumer: waits for a published batch.
+    const Batch &beginRead()
+    {
+        size_t h = head.load(memory_order_relaxed);
+        wait([&]() { return tail.load(memory_order_acquire) != h; });
+        return slots[h % CAPACITY];
+    }
+
+    // Consumer: hands the slot returned by beginRead() back to the producer.
+    void commitRead()
+    {
+        head.store(head.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+private:
+    vector<Batch> slots;
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+
+    template <typename Ready>
+    static void wait(Ready ready)
+    {
+        for (int spins = 0; !ready(); spins++)
+        {
+            if (spins > 64)
+            {
+                sched_yield();
+            }
+        }
+    }
+};
+
+// Runs on the lexer thread: lexes the whole source into ring, a batch at a
+// time, ending with the T_EOF token.
+template <typename Dialect>
+void produceTokens(BasicLexer<Dialect> &lexer, TokenRing &ring)
+{
+    bool done = false;
+    while (!done)
+    {
+        TokenRing::Batch &batch = ring.beginWrite();
+        batch.count = 0;
+        while (batch.count < TokenRing::BATCH_SIZE && !done)
+        {
+            batch.tokens[batch.count] = lexer.next();
+            done = batch.tokens[batch.count].type == T_EOF;
+            batch.count++;
+        }
+        ring.commitWrite();
+    }
+}
+
+// The Parser reads tokens through a TokenStream, which keeps only a small
+// lookahead window. Streaming from a Lexer means tokens are produced as the
+// parser asks for them and the full token array never exists. The stream can
+// also consume batches a lexer thread publishes to a TokenRing, or replay an
+// already lexed Token array or TokenStore (e.g. from tokenizeParallel).
+class TokenStream
+{
+public:
+    static const size_t LOOKAHEAD = 4;
+
+    template <typename Dialect>
+    TokenStream(BasicLexer<Dialect> &lexer)
+        : lexer(&lexer), pullLexer([](void *lexer)
+                                   { return static_cast<BasicLexer<Dialect> *>(lexer)->next(); }) {}
+
+    TokenStream(TokenRing &ring) : ring(&ring) {}
+
+    TokenStream(vector<Token> tokens) : buffered(move(tokens)) {}
+
+    TokenStream(TokenStore tokens) : store(move(tokens)), replayingStore(true) {}
+
+    // Replays tokens [first, last) of shared, which must outlive the stream,
+    // then an end of file token placed where token last starts.
+    TokenStream(const TokenStore &shared, size_t first, size_t last)
+        : shared(&shared), storePos(first), sharedEnd(last) {}
+
+    // Token k positions ahead of the current one, k < LOOKAHEAD.
+    const Token &peek(size_t k = 0)
+    {
+        while (count <= k)
+        {
+            window[(head + count) % LOOKAHEAD] = pull();
+            count++;
+        }
+        return window[(head + k) % LOOKAHEAD];
+    }
+
+    Token advance()
+    {
+        Token token = peek();
+        if (token.type != T_EOF)
+        {
+            head = (head + 1) % LOOKAHEAD;
+            count--;
+        }
+        return token;
+    }
+
+    // The TokenStore this stream replays, if it owns one and has not started
+    // reading it yet.
+    const TokenStore *unreadStore() const
+    {
+        return replayingStore && storePos == 0 && count == 0 ? &store : nullptr;
+    }
+
+private:
+    void *lexer = nullptr; // a BasicLexer of some dialect, read with pullLexer
+    Token (*pullLexer)(void *lexer) = nullptr;
+    TokenRing *ring = nullptr;
+    const TokenRing::Batch *batch = nullptr;
+    size_t batchPos = 0;
+    vector<Token> buffered;
+    size_t bufferedPos = 0;
+    TokenStore store;
+    const TokenStore *shared = nullptr;
+    size_t storePos = 0;
+    size_t sharedEnd = 0;
+    bool replayingStore = false;
+    Token window[LOOKAHEAD];
+    size_t head = 0;
+    size_t count = 0;
+    bool finished = false;
+    Token eof;
+
+    Token pull()
+    {
+        if (finished)
+        {
+            return eof;
+        }
+        Token token;
+        if (lexer != nullptr)
+        {
+            token = pullLexer(lexer);
+        }
+        else if (ring != nullptr)
+        {
+            if (batch == nullptr)
+            {
+                batch = &ring->beginRead();
+                batchPos = 0;
+            }
+            token = batch->tokens[batchPos++];
+            if (batchPos == batch->count)
+            {
+                ring->commitRead();
+                batch = nullptr;
+            }
+        }
+        else if (replayingStore)
+        {
+            token = store.token(storePos++);
+        }
+        else if (shared != nullptr)
+        {
+            if (storePos < sharedEnd)
+                token = shared->token(storePos++);
+            else
+                token = Token{T_EOF, NO_SYMBOL, shared->source().substr(shared->offset(sharedEnd), 0)};
+        }
+        else
+        {
+            token = buffered[bufferedPos++];
+        }
+        if (token.type == T_EOF)
+        {
+            finished = true;
+            eof = token;
+        }
+        return token;
+    }
+};
+
+// Bump allocator for the AST. Nodes are carved out of large blocks and never
+// freed one at a time: the whole tree goes when the arena does, so nodes must
+// be trivially destructible (string_views and pointers, no owning members).
+class Arena
+{
+public:
+    Arena() {}
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align)
+    {
+        size_t padding = -reinterpret_cast<uintptr_t>(cursor) & (align - 1);
+        if (padding + size > static_cast<size_t>(limit - cursor))
+        {
+            size_t blockSize = max(BLOCK_SIZE, size + align);
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            limit = cursor + blockSize;
+            padding = -reinterpret_cast<uintptr_t>(cursor) & (align - 1);
+        }
+        char *at = cursor + padding;
+        cursor = at + size;
+        return at;
+    }
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        static_assert(is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T{forward<Args>(args)...};
+    }
+
+    string_view copy(string_view text)
+    {
+        char *at = static_cast<char *>(allocate(text.size(), 1));
+        memcpy(at, text.data(), text.size());
+        return string_view(at, text.size());
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+};
+
+// A run of nodes copied into an arena.
+template <typename T>
+struct NodeList
+{
+    T *const *items;
+    size_t count;
+
+    T *const *begin() const { return items; }
+    T *const *end() const { return items + count; }
+
+    static NodeList copy(Arena &arena, T *const *first, T *const *last)
+    {
+        size_t count = static_cast<size_t>(last - first);
+        T **items = static_cast<T **>(arena.allocate(count * sizeof(T *), alignof(T *)));
+        copy_n(first, count, items);
+        return NodeList{items, count};
+    }
+
+    static NodeList copy(Arena &arena, const vector<T *> &nodes)
+    {
+        return copy(arena, nodes.data(), nodes.data() + nodes.size());
+    }
+};
+
+// Static type of an expression, worked out as the tree is built and checked
+// when the expression is assigned.
+enum ValueType : uint8_t
+{
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_STRING
+};
+
+inline ValueType valueTypeOf(string_view typeName)
+{
+    if (typeName == "float")
+        return TYPE_FLOAT;
+    if (typeName == "bool")
+        return TYPE_BOOL;
+    if (typeName == "string")
+        return TYPE_STRING;
+    return TYPE_INT;
+}
+
+inline const char *typeName(ValueType type)
+{
+    static const char *const NAMES[] = {"int", "float", "bool", "string"};
+    return NAMES[type];
+}
+
+// Expressions. text is how three-address code refers to a leaf: the
+// variable name or the literal as written (or, for a folded constant, its
+// folded value). Binary nodes get a virtual register when they are lowered.
+enum ExprKind : uint8_t
+{
+    EXPR_VARIABLE,
+    EXPR_LITERAL, // bool and string literals
+    EXPR_INT,
+    EXPR_FLOAT,
+    EXPR_BINARY
+};
+
+struct Expr
+{
+    ExprKind kind;
+    ValueType type;
+    string_view text;
+
+    bool isConstant() const { return kind == EXPR_INT || kind == EXPR_FLOAT; }
+};
+
+// entry is the SymbolTable entry the semantic checks resolved the name to,
+// which tells a variable from the ones it shadows or is shadowed by.
+struct VariableExpr : Expr
+{
+    uint32_t symbolId;
+    uint32_t entry;
+};
+
+struct ConstantExpr : Expr
+{
+    NumericLiteral value;
+
+    double asDouble() const { return kind == EXPR_INT ? static_cast<double>(value.intValue) : value.floatValue; }
+};
+
+struct BinaryExpr : Expr
+{
+    string_view op;
+    Expr *left;
+    Expr *right;
+};
+
+// Statements. Optional parts (an initializer, an else branch, a for-loop
+// step) are null when absent.
+enum StmtKind : uint8_t
+{
+    STMT_DECLARATION,
+    STMT_ASSIGNMENT,
+    STMT_IF,
+    STMT_WHILE,
+    STMT_FOR,
+    STMT_DO_WHILE,
+    STMT_RETURN,
+    STMT_BLOCK
+};
+
+struct Stmt
+{
+    StmtKind kind;
+};
+
+struct DeclarationStmt : Stmt
+{
+    string_view name;
+    uint32_t symbolId;
+    string_view type;
+    Expr *init;
+    uint32_t entry;
+};
+
+struct AssignmentStmt : Stmt
+{
+    string_view name;
+    uint32_t symbolId;
+    Expr *value;
+    uint32_t entry;
+};
+
+struct IfStmt : Stmt
+{
+    Expr *condition;
+    Stmt *thenBranch;
+    Stmt *elseBranch;
+};
+
+struct WhileStmt : Stmt
+{
+    Expr *condition;
+    Stmt *body;
+};
+
+struct ForStmt : Stmt
+{
+    Stmt *init;
+    Expr *condition;
+    Stmt *step;
+    Stmt *body;
+};
+
+struct DoWhileStmt : Stmt
+{
+    Stmt *body;
+    Expr *condition;
+};
+
+struct ReturnStmt : Stmt
+{
+    Expr *value;
+};
+
+struct BlockStmt : Stmt
+{
+    NodeList<Stmt> statements;
+};
+
+// Lowers a parsed program to three-address code in source order: each
+// statement's expressions are walked left to right and every binary node
+// takes the next virtual register. Both walks keep their own stacks, so a
+// deeply nested program cannot overflow the native one.
+class TACLowering
+{
+public:
+    // symbols is the table the semantic checks resolved the program's names
+    // with. Without one, as when a segment is lowered before the checks have
+    // run, variables are named by their source name, which is only right if
+    // no name is declared twice.
+    TACLowering(TACGenerator &tacGen, SymbolTable *symbols = nullptr) : tacGen(tacGen), symbols(symbols) {}
+
+    void lowerProgram(const NodeList<Stmt> &program)
+    {
+        for (Stmt *stmt : program)
+        {
+            lowerStatement(stmt);
+        }
+    }
+
+private:
+    // The statements [next, end) still to lower, such as the rest of a
+    // block, and then, if loop is set, the condition and jump back to label
+    // that close a do-while.
+    struct Task
+    {
+        const Stmt *const *next;
+        const Stmt *const *end;
+        const DoWhileStmt *loop;
+        uint32_t label;
+    };
+
+    TACGenerator &tacGen;
+    SymbolTable *symbols;
+    vector<Task> tasks;
+    vector<const Expr *> pending;
+    vector<TACOperand> values;
+
+    static Task taskFor(Stmt *const &stmt) { return Task{&stmt, &stmt + 1, nullptr, 0}; }
+
+    // Variables keep their symbol id on both lowering paths; when the check
+    // walk resolved the declaration, the entry and its name.N listing name
+    // tell a variable apart from one it shadows.
+    TACOperand variable(uint32_t symbolId, uint32_t entry, string_view name) const
+    {
+        if (symbols == nullptr || entry == SymbolTable::NO_ENTRY)
+        {
+            return TACOperand::symbol(symbolId, name);
+        }
+        return TACOperand::symbol(symbolId, symbols->nameOf(entry), entry);
+    }
+
+    void lowerStatement(Stmt *root)
+    {
+        size_t base = tasks.size();
+        tasks.push_back(taskFor(root));
+        while (tasks.size() > base)
+        {
+            Task &task = tasks.back();
+            if (task.next == task.end)
+            {
+                Task finished = task;
+                tasks.pop_back();
+                if (finished.loop != nullptr)
+                {
+                    tacGen.generateIfGoto(lowerExpression(finished.loop->condition), finished.label);
+                }
+                continue;
+            }
+            const Stmt *stmt = *task.next++;
+            switch (stmt->kind)
+            {
+            case STMT_DECLARATION:
+            {
+                const DeclarationStmt *decl = static_cast<const DeclarationStmt *>(stmt);
+                if (decl->init != nullptr)
+                {
+                    tacGen.generateAssign(variable(decl->symbolId, decl->entry, decl->name), lowerExpression(decl->init));
+                }
+                break;
+            }
+            case STMT_ASSIGNMENT:
+            {
+                const AssignmentStmt *assign = static_cast<const AssignmentStmt *>(stmt);
+                tacGen.generateAssign(variable(assign->symbolId, assign->entry, assign->name), lowerExpression(assign->value));
+                break;
+            }
+            case STMT_IF:
+            {
+                const IfStmt *ifStmt = static_cast<const IfStmt *>(stmt);
+                lowerExpression(ifStmt->condition);
+                if (ifStmt->elseBranch != nullptr)
+                {
+                    tasks.push_back(taskFor(ifStmt->elseBranch));
+                }
+                tasks.push_back(taskFor(ifStmt->thenBranch));
+                break;
+            }
+            case STMT_WHILE:
+            {
+                const WhileStmt *loop = static_cast<const WhileStmt *>(stmt);
+                lowerExpression(loop->condition);
+                tasks.push_back(taskFor(loop->body));
+                break;
+            }
+            case STMT_FOR:
+            {
+                // The init and step are simple statements
+                const ForStmt *loop = static_cast<const ForStmt *>(stmt);
+                tasks.push_back(taskFor(loop->body));
+                if (loop->step != nullptr)
+                {
+                    tasks.push_back(taskFor(loop->step));
+                }
+                lowerStatement(loop->init);
+                lowerExpression(loop->condition);
+                break;
+            }
+            case STMT_DO_WHILE:
+            {
+                const DoWhileStmt *loop = static_cast<const DoWhileStmt *>(stmt);
+                tasks.push_back(Task{nullptr, nullptr, loop, tacGen.generateLabel()});
+                tasks.push_back(taskFor(loop->body));
+                break;
+            }
+            case STMT_RETURN:
+                tacGen.generateAssign(TACOperand::symbol(NO_SYMBOL, "return_value"), lowerExpression(static_cast<const ReturnStmt *>(stmt)->value));
+                break;
+            case STMT_BLOCK:
+            {
+                const NodeList<Stmt> &statements = static_cast<const BlockStmt *>(stmt)->statements;
+                tasks.push_back(Task{statements.begin(), statements.end(), nullptr, 0});
+                break;
+            }
+            }
+        }
+    }
+
+    TACOperand leafOperand(const Expr *expr) const
+    {
+        switch (expr->kind)
+        {
+        case EXPR_VARIABLE:
+        {
+            const VariableExpr *var = static_cast<const VariableExpr *>(expr);
+            return variable(var->symbolId, var->entry, expr->text);
+        }
+        case EXPR_INT:
+            return TACOperand::constant(TACOperand::INT_CONSTANT, static_cast<const ConstantExpr *>(expr)->value, expr->text);
+        case EXPR_FLOAT:
+            return TACOperand::constant(TACOperand::FLOAT_CONSTANT, static_cast<const ConstantExpr *>(expr)->value, expr->text);
+        default:
+            return TACOperand::literal(expr->text);
+        }
+    }
+
+    // Returns the operand holding the value of expr. The walk runs down
+    // left operands, leaving binary nodes on the stack; a null above one
+    // marks that its right operand is under way. Once both operand values
+    // are on the value stack the node takes its temp.
+    TACOperand lowerExpression(const Expr *root)
+    {
+        size_t base = pending.size();
+        const Expr *expr = root;
+        while (true)
+        {
+            while (expr->kind == EXPR_BINARY)
+            {
+                pending.push_back(expr);
+                expr = static_cast<const BinaryExpr *>(expr)->left;
+            }
+            values.push_back(leafOperand(expr));
+            while (pending.size() > base && pending.back() == nullptr)
+            {
+                pending.pop_back();
+                const BinaryExpr *binary = static_cast<const BinaryExpr *>(pending.back());
+                pending.pop_back();
+                TACOperand right = values.back();
+                values.pop_back();
+                TACOperand left = values.back();
+                values.pop_back();
+                TACOperand temp = tacGen.newTemp();
+                tacGen.generate(binary->op, left, right, temp);
+                values.push_back(temp);
+            }
+            if (pending.size() == base)
+            {
+                break;
+            }
+            expr = static_cast<const BinaryExpr *>(pending.back())->right;
+            pending.push_back(nullptr);
+        }
+        TACOperand result = values.back();
+        values.pop_back();
+        return result;
+    }
+};
+
+// Binding power of each binary operator token; higher binds tighter and 0
+// means the token does not continue an expression. Adding an operator is a
+// matter of giving its token a power here (and folding it, if constant) and
+// listing it in the dialects that have it.
+constexpr uint8_t operatorPower(TokenTypeValue type)
+{
+    switch (type)
+    {
+    case T_OR:
+        return 1;
+    case T_AND:
+        return 2;
+    case T_EQ:
+    case T_NEQ:
+        return 3;
+    case T_LT:
+    case T_GT:
+    case T_LE:
+    case T_GE:
+        return 4;
+    case T_PLUS:
+    case T_MINUS:
+        return 5;
+    case T_MUL:
+    case T_DIV:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+// The binding power of each token in Dialect, 0 for operators it lacks.
+template <typename Dialect>
+struct BindingPowerTable
+{
+    uint8_t of[TOKEN_TYPE_COUNT];
+
+    constexpr BindingPowerTable() : of()
+    {
+        for (TokenTypeValue type : Dialect::OPERATORS)
+        {
+            of[type] = operatorPower(type);
+        }
+    }
+};
+
+template <typename Dialect>
+constexpr BindingPowerTable<Dialect> BINDING_POWER;
+
+// How error messages name each token type; keywords are named as Dialect
+// spells them.
+template <typename Dialect>
+struct TokenNameTable
+{
+    const char *of[TOKEN_TYPE_COUNT];
+
+    constexpr TokenNameTable() : of()
+    {
+        for (const char *&name : of)
+            name = "";
+        of[T_ID] = "identifier";
+        of[T_NUM] = "number";
+        of[T_ASSIGN] = "=";
+        of[T_PLUS] = "+";
+        of[T_MINUS] = "-";
+        of[T_EQ] = "==";
+        of[T_NEQ] = "!=";
+        of[T_MUL] = "*";
+        of[T_DIV] = "/";
+        of[T_LPAREN] = "(";
+        of[T_RPAREN] = ")";
+        of[T_LBRACE] = "{";
+        of[T_RBRACE] = "}";
+        of[T_SEMICOLON] = ";";
+        of[T_GT] = ">";
+        of[T_LT] = "<";
+        of[T_GE] = ">=";
+        of[T_LE] = "<=";
+        of[T_AND] = "&&";
+        of[T_OR] = "||";
+        of[T_EOF] = "end of file";
+        for (const Keyword &keyword : Dialect::KEYWORDS)
+        {
+            if (keyword.type != T_BOOL_LITERAL)
+                of[keyword.type] = keyword.text.data();
+        }
+    }
+};
+
+template <typename Dialect>
+constexpr TokenNameTable<Dialect> TOKEN_NAME;
+
+// A problem found while compiling one source, at a byte offset into it.
+struct Diagnostic
+{
+    size_t offset;
+    string message;
+};
+
+// Parses, checks and lowers programs written in Dialect; Parser is the
+// English one.
+template <typename Dialect>
+class BasicParser
+{
+public:
+    // source is the buffer the tokens view; it is only read to place
+    // diagnostics.
+    BasicParser(string_view source, TokenStream tokens, TACGenerator &tacGen)
+        : tokens(move(tokens)), source(source), lines(source), tacGen(tacGen)
+    {
+    }
+
+    // Parses and checks the whole program into an AST, then lowers it to
+    // three-address code and assembly, listed to out. If any errors were
+    // found they are written to errors instead and false is returned.
+    bool parseProgram(ostream &out = cout, ostream &errors = cerr)
+    {
+        if (!compile())
+        {
+            printDiagnostics(errors);
+            return false;
+        }
+        out << "Parsing completed successfully! No Syntax Error" << endl;
+        symbolTable.display(out);
+        tacGen.printTAC(out);
+        tacGen.generateAssembly(out);
+        return true;
+    }
+
+    // Parses, checks and lowers the program into the TACGenerator without
+    // printing anything. Returns false, having lowered nothing, if there
+    // were errors.
+    bool compile()
+    {
+        parse();
+        if (!diagnostics.empty())
+        {
+            return false;
+        }
+        // Segments were lowered before the checks, by source name, which
+        // does not tell apart two declarations of the same name
+        if (!lowerFromFragments || symbolTable.redeclarations > 0)
+        {
+            TACLowering(tacGen, &symbolTable).lowerProgram(program);
             return true;
+        }
+        size_t total = tacGen.tac.size();
+        for (const unique_ptr<Segment> &segment : segments)
+        {
+            total += segment->fragment.tac.size();
+        }
+        tacGen.tac.reserve(total);
+        for (const unique_ptr<Segment> &segment : segments)
+        {
+            tacGen.append(segment->fragment);
+        }
+        return true;
+    }
+
+    // Parses and checks the whole program into an AST without lowering it.
+    // Errors do not stop the parse: each is recorded in the diagnostics and
+    // the parser recovers at the next statement, so the tree is only
+    // meaningful when getDiagnostics() is empty.
+    const NodeList<Stmt> &parse()
+    {
+        if (!parseSegments())
+        {
+            setProgram(parseStatements());
+        }
+        check();
+        return program;
+    }
+
+    const NodeList<Stmt> &getProgram() const { return program; }
+
+    const vector<Diagnostic> &getDiagnostics() const { return diagnostics; }
+
+    // Brings the tree up to date after relex() applied edit to store, the
+    // TokenStore the program was parsed from; unchangedFrom is what relex()
+    // returned. Top-level statements that end before the edit, and those
+    // that start where relexing found the old tokens again, keep their
+    // subtrees; only the statements in between are parsed again. An if
+    // without an else just before the edit is parsed again too, since the
+    // edit may have given it one. After a parse with syntax errors, or when
+    // relex() had to lex the whole source again, the whole program is parsed
+    // again.
+    //
+    // Reused subtrees have their views moved onto the new buffer, and the
+    // semantic checks run again over the whole tree, since declaration order
+    // makes them global; both are walks over the tree that read no tokens.
+    // Replaced subtrees stay in the arena until the Parser is destroyed; the
+    // top-level list itself is not kept there, so it is replaced in place.
+    const NodeList<Stmt> &reparse(const TokenStore &store, const SourceEdit &edit, size_t unchangedFrom)
+    {
+        string_view old = source;
+        source = store.source();
+        lines = LineIndex(source);
+        size_t shift = edit.inserted.size() - edit.removed; // modulo arithmetic
+        bool reuse = syntaxErrors == 0 && unchangedFrom != RELEXED_WHOLE_SOURCE;
+        diagnostics.clear();
+        syntaxErrors = 0;
+        symbolTable = SymbolTable();
+        lowerFromFragments = false;
+
+        vector<Span> oldSpans = move(spans);
+        spans.clear();
+        size_t kept = 0;
+        if (reuse)
+        {
+            while (kept < oldSpans.size() && oldSpans[kept].end <= edit.offset)
+            {
+                kept++;
+            }
+            if (kept > 0 && takesElse(program.items[kept - 1]))
+            {
+                kept--;
+            }
+        }
+        vector<Stmt *> statements(program.begin(), program.begin() + kept);
+        spans.assign(oldSpans.begin(), oldSpans.begin() + kept);
+        for (Stmt *stmt : statements)
+        {
+            rebaseStatement(stmt, old, 0);
+        }
+
+        size_t from = kept == 0 ? 0 : oldSpans[kept - 1].end;
+        tokens = TokenStream(store, store.lowerBound(from), store.size());
+        size_t resume = oldSpans.size();
+        size_t next = kept;
+        while (peek().type != T_EOF)
+        {
+            size_t at = offsetOf(peek());
+            if (reuse && at >= unchangedFrom)
+            {
+                size_t oldAt = at - shift;
+                while (next < oldSpans.size() && oldSpans[next].start < oldAt)
+                {
+                    next++;
+                }
+                if (next < oldSpans.size() && oldSpans[next].start == oldAt)
+                {
+                    resume = next;
+                    break;
+                }
+            }
+            parseTopLevelStatement(statements);
+        }
+        for (size_t i = resume; i < oldSpans.size(); i++)
+        {
+            rebaseStatement(program.items[i], old, shift);
+            statements.push_back(program.items[i]);
+            spans.push_back(Span{oldSpans[i].start + shift, oldSpans[i].end + shift});
+        }
+        setProgram(move(statements));
+        check();
+        return program;
+    }
+
+    // Lets parse() split a program replayed from a TokenStore into runs of
+    // top-level statements and parse and lower the runs on up to threadCount
+    // threads. Programs too small to give every run minSegmentTokens tokens
+    // are still parsed on the calling thread.
+    void setParseThreads(size_t threadCount, size_t minSegmentTokens = 1 << 16)
+    {
+        parseThreads = threadCount;
+        this->minSegmentTokens = max<size_t>(minSegmentTokens, 1);
+    }
+
+private:
+    // Thrown once a syntax error has been recorded, to unwind to the
+    // innermost statement list, which synchronizes and carries on.
+    struct SyntaxError
+    {
+    };
+
+    // A run of top-level statements parsed and lowered on its own. Its
+    // temporaries and labels are numbered from zero and rebased when the
+    // fragment is appended to the program's code.
+    struct Segment
+    {
+        TACGenerator fragment;
+        unique_ptr<BasicParser> parser;
+    };
+
+    struct SegmentQueue
+    {
+        vector<unique_ptr<Segment>> *segments;
+        atomic<size_t> next;
+    };
+
+    // The bytes [start, end) of the source a top-level statement came from.
+    struct Span
+    {
+        size_t start;
+        size_t end;
+    };
+
+    enum FrameKind : uint8_t
+    {
+        FRAME_BLOCK,
+        FRAME_IF_THEN,
+        FRAME_IF_ELSE,
+        FRAME_WHILE,
+        FRAME_FOR,
+        FRAME_DO
+    };
+
+    // A compound statement waiting for a child. condition, first (a for
+    // loop's init or an if's then branch) and second (a for loop's step)
+    // hold the parts already parsed.
+    struct Frame
+    {
+        FrameKind kind;
+        Expr *condition;
+        Stmt *first;
+        Stmt *second;
+        size_t blockStart;
+    };
+
+    // The rule that parses a statement starting with each token type;
+    // tokens that cannot start one get unexpectedStatement. Built at compile
+    // time and defined after the class, which it needs complete.
+    struct StatementRuleTable
+    {
+        using Rule = Stmt *(BasicParser::*)();
+        Rule of[TOKEN_TYPE_COUNT];
+
+        constexpr StatementRuleTable() : of()
+        {
+            for (Rule &rule : of)
+                rule = &BasicParser::unexpectedStatement;
+            of[T_INT] = of[T_FLOAT] = of[T_STRING] = of[T_BOOL] = &BasicParser::parseDeclaration;
+            of[T_ID] = &BasicParser::parseAssignment;
+            of[T_LBRACE] = &BasicParser::beginBlock;
+            enable(T_RETURN, &BasicParser::parseReturnStatement);
+            enable(T_IF, &BasicParser::beginIfStatement);
+            enable(T_WHILE, &BasicParser::beginWhileLoop);
+            enable(T_FOR, &BasicParser::beginForLoop);
+            enable(T_DO, &BasicParser::beginDoWhileLoop);
+        }
+
+        // Statements the dialect does not have keep unexpectedStatement
+        constexpr void enable(TokenTypeValue first, Rule rule)
+        {
+            if (containsToken(Dialect::STATEMENTS, first))
+                of[first] = rule;
+        }
+    };
+
+    static const StatementRuleTable STATEMENT_RULES;
+
+    struct PendingOperator
+    {
+        string_view op;
+        uint8_t power;
+    };
+
+    // The statements [next, end) still to check, then condition, if set.
+    // The statements of a block are a task of their own that leaves the
+    // block's scope when done.
+    struct CheckTask
+    {
+        Stmt *const *next;
+        Stmt *const *end;
+        Expr *condition;
+        bool block;
+    };
+
+    TokenStream tokens;
+    string_view source;
+    LineIndex lines;
+    vector<Diagnostic> diagnostics;
+    SymbolTable symbolTable;
+    TACGenerator &tacGen;
+    Arena arena;
+    NodeList<Stmt> program = {nullptr, 0}; // views topLevel
+    vector<Stmt *> topLevel;
+    size_t parseThreads = 1;
+    size_t minSegmentTokens = 1 << 16;
+    vector<unique_ptr<Segment>> segments;
+    bool lowerFromFragments = false;
+    vector<Span> spans; // one per statement of program
+    size_t previousEnd = 0; // end of the last token consumed
+    size_t syntaxErrors = 0;
+
+    // Work stacks of the iterative parse and walks, kept between uses so
+    // their storage is reused.
+    vector<Frame> frames;
+    vector<Stmt *> blockItems;
+    vector<Expr *> operands;
+    vector<PendingOperator> operators;
+    vector<CheckTask> checkTasks;
+    vector<Stmt *> pendingStatements;
+    vector<Expr *> pendingExpressions;
+
+    vector<Stmt *> parseStatements()
+    {
+        vector<Stmt *> statements;
+        while (peek().type != T_EOF)
+        {
+            parseTopLevelStatement(statements);
+        }
+        return statements;
+    }
+
+    // The top-level statements live outside the arena, since reparse()
+    // replaces them on every edit.
+    void setProgram(vector<Stmt *> statements)
+    {
+        topLevel = move(statements);
+        program = NodeList<Stmt>{topLevel.data(), topLevel.size()};
+    }
+
+    void parseTopLevelStatement(vector<Stmt *> &statements)
+    {
+        size_t start = offsetOf(peek());
+        try
+        {
+            statements.push_back(parseStatement());
+            spans.push_back(Span{start, previousEnd});
+        }
+        catch (const SyntaxError &)
+        {
+            // A '}' with no block open to close it. One met only after
+            // recovery is left for the next statement to report.
+            if (synchronize())
+            {
+                advance();
+            }
+        }
+    }
+
+    void check()
+    {
+        for (Stmt *stmt : program)
+        {
+            checkStatement(stmt);
+        }
+        stable_sort(diagnostics.begin(), diagnostics.end(), [](const Diagnostic &a, const Diagnostic &b)
+                    { return a.offset < b.offset; });
+    }
+
+    // True if an else following stmt would belong to it.
+    static bool takesElse(const Stmt *stmt)
+    {
+        while (stmt->kind == STMT_IF)
+        {
+            const IfStmt *branch = static_cast<const IfStmt *>(stmt);
+            if (branch->elseBranch == nullptr)
+            {
+                return true;
+            }
+            stmt = branch->elseBranch;
+        }
+        return false;
+    }
+
+    // Moves a view into old onto the same bytes of source, which sit shift
+    // bytes further on. Views outside old (folded constants, which live in
+    // the arena) stay as they are.
+    void rebase(string_view &view, string_view old, size_t shift)
+    {
+        less_equal<const char *> notAfter;
+        if (notAfter(old.data(), view.data()) && notAfter(view.data(), old.data() + old.size()))
+        {
+            size_t offset = static_cast<size_t>(view.data() - old.data()) + shift;
+            view = string_view(source.data() + offset, view.size());
+        }
+    }
+
+    void rebaseStatement(Stmt *root, string_view old, size_t shift)
+    {
+        if (old.data() == source.data() && shift == 0)
+        {
+            return;
+        }
+        vector<Stmt *> &pending = pendingStatements;
+        pending.push_back(root);
+        while (!pending.empty())
+        {
+            Stmt *stmt = pending.back();
+            pending.pop_back();
+            switch (stmt->kind)
+            {
+            case STMT_DECLARATION:
+            {
+                DeclarationStmt *decl = static_cast<DeclarationStmt *>(stmt);
+                rebase(decl->name, old, shift);
+                rebase(decl->type, old, shift);
+                if (decl->init != nullptr)
+                    rebaseExpression(decl->init, old, shift);
+                break;
+            }
+            case STMT_ASSIGNMENT:
+            {
+                AssignmentStmt *assign = static_cast<AssignmentStmt *>(stmt);
+                rebase(assign->name, old, shift);
+                rebaseExpression(assign->value, old, shift);
+                break;
+            }
+            case STMT_IF:
+            {
+                IfStmt *branch = static_cast<IfStmt *>(stmt);
+                rebaseExpression(branch->condition, old, shift);
+                pending.push_back(branch->thenBranch);
+                if (branch->elseBranch != nullptr)
+                    pending.push_back(branch->elseBranch);
+                break;
+            }
+            case STMT_WHILE:
+            {
+                WhileStmt *loop = static_cast<WhileStmt *>(stmt);
+                rebaseExpression(loop->condition, old, shift);
+                pending.push_back(loop->body);
+                break;
+            }
+            case STMT_FOR:
+            {
+                ForStmt *loop = static_cast<ForStmt *>(stmt);
+                pending.push_back(loop->init);
+                rebaseExpression(loop->condition, old, shift);
+                if (loop->step != nullptr)
+                    pending.push_back(loop->step);
+                pending.push_back(loop->body);
+                break;
+            }
+            case STMT_DO_WHILE:
+            {
+                DoWhileStmt *loop = static_cast<DoWhileStmt *>(stmt);
+                pending.push_back(loop->body);
+                rebaseExpression(loop->condition, old, shift);
+                break;
+            }
+            case STMT_RETURN:
+                rebaseExpression(static_cast<ReturnStmt *>(stmt)->value, old, shift);
+                break;
+            case STMT_BLOCK:
+                for (Stmt *inner : static_cast<BlockStmt *>(stmt)->statements)
+                {
+                    pending.push_back(inner);
+                }
+                break;
+            }
+        }
+    }
+
+    void rebaseExpression(Expr *root, string_view old, size_t shift)
+    {
+        vector<Expr *> &pending = pendingExpressions;
+        pending.push_back(root);
+        while (!pending.empty())
+        {
+            Expr *expr = pending.back();
+            pending.pop_back();
+            rebase(expr->text, old, shift);
+            if (expr->kind == EXPR_BINARY)
+            {
+                BinaryExpr *binary = static_cast<BinaryExpr *>(expr);
+                rebase(binary->op, old, shift);
+                pending.push_back(binary->left);
+                pending.push_back(binary->right);
+            }
+        }
+    }
+
+    // Top-level statements end at a ';' or '}' outside any braces and
+    // parentheses, unless an else or while follows and the statement goes
+    // on. The scan only reads the token kinds. A boundary is taken at the
+    // first such point after each of the evenly spaced targets.
+    static vector<size_t> findStatementBoundaries(const TokenStore &store, size_t segmentCount)
+    {
+        vector<size_t> bounds = {0};
+        size_t last = store.size() - 1; // the EOF token
+        size_t target = last / segmentCount;
+        int braces = 0, parens = 0;
+        for (size_t i = 0; i < last && bounds.size() < segmentCount; i++)
+        {
+            TokenTypeValue kind = store.kind(i);
+            if (kind == T_LBRACE)
+                braces++;
+            else if (kind == T_RBRACE)
+                braces--;
+            else if (kind == T_LPAREN)
+                parens++;
+            else if (kind == T_RPAREN)
+                parens--;
+            if (i + 1 < target || braces != 0 || parens != 0 || (kind != T_SEMICOLON && kind != T_RBRACE))
+                continue;
+            TokenTypeValue next = store.kind(i + 1);
+            if (next == T_ELSE || next == T_WHILE)
+                continue;
+            bounds.push_back(i + 1);
+            target = last * bounds.size() / segmentCount;
+        }
+        bounds.push_back(store.size());
+        return bounds;
+    }
+
+    static void *parseSegmentsThread(void *arg)
+    {
+        SegmentQueue *queue = (SegmentQueue *)arg;
+        size_t i;
+        while ((i = queue->next++) < queue->segments->size())
+        {
+            Segment &segment = *(*queue->segments)[i];
+            BasicParser &parser = *segment.parser;
+            parser.setProgram(parser.parseStatements());
+            if (parser.diagnostics.empty())
+            {
+                TACLowering(segment.fragment).lowerProgram(parser.program);
+            }
+        }
+        return NULL;
+    }
+
+    // Parses and lowers the program as segments on parseThreads threads;
+    // false if it is not worth it or not possible. The semantic checks still
+    // run afterwards on this thread, over the joined tree in source order.
+    // A syntax error may have sent a segment's recovery past its boundary,
+    // so then the whole program is parsed again sequentially and reported
+    // exactly as a sequential parse would.
+    bool parseSegments()
+    {
+        const TokenStore *store = tokens.unreadStore();
+        if (parseThreads <= 1 || store == nullptr)
+        {
+            return false;
+        }
+        size_t segmentCount = min(parseThreads * 4, store->size() / minSegmentTokens);
+        if (segmentCount <= 1)
+        {
+            return false;
+        }
+
+        vector<size_t> bounds = findStatementBoundaries(*store, segmentCount);
+        for (size_t i = 0; i + 1 < bounds.size(); i++)
+        {
+            unique_ptr<Segment> segment = make_unique<Segment>();
+            segment->parser = make_unique<BasicParser>(source, TokenStream(*store, bounds[i], bounds[i + 1]), segment->fragment);
+            segments.push_back(move(segment));
+        }
+        SegmentQueue queue{&segments, {0}};
+        vector<pthread_t> tids(min(parseThreads, segments.size()));
+        for (pthread_t &tid : tids)
+        {
+            pthread_create(&tid, NULL, parseSegmentsThread, &queue);
+        }
+        for (pthread_t &tid : tids)
+        {
+            pthread_join(tid, NULL);
+        }
+
+        size_t total = 0;
+        for (const unique_ptr<Segment> &segment : segments)
+        {
+            if (!segment->parser->diagnostics.empty())
+            {
+                segments.clear();
+                return false;
+            }
+            total += segment->parser->program.count;
+        }
+        vector<Stmt *> statements;
+        statements.reserve(total);
+        spans.reserve(total);
+        for (const unique_ptr<Segment> &segment : segments)
+        {
+            statements.insert(statements.end(), segment->parser->program.begin(), segment->parser->program.end());
+            spans.insert(spans.end(), segment->parser->spans.begin(), segment->parser->spans.end());
+        }
+        setProgram(move(statements));
+        lowerFromFragments = true;
+        return true;
+    }
+
+    // Semantic checks walk the finished tree in source order, so the symbol
+    // table sees declarations in the same order however the statements were
+    // parsed. They also give variables, and the expressions built on them,
+    // their types. Each task is a run of statements still to check, such
+    // as the rest of a block; a do-while's condition waits in a task of its
+    // own under the body, since it is checked after it.
+    void checkStatement(Stmt *root)
+    {
+        size_t base = checkTasks.size();
+        checkTasks.push_back(CheckTask{&root, &root + 1, nullptr, false});
+        while (checkTasks.size() > base)
+        {
+            CheckTask &task = checkTasks.back();
+            if (task.next == task.end)
+            {
+                Expr *condition = task.condition;
+                if (task.block)
+                {
+                    symbolTable.exitScope();
+                }
+                checkTasks.pop_back();
+                if (condition != nullptr)
+                {
+                    checkExpression(condition);
+                }
+                continue;
+            }
+            Stmt *stmt = *task.next++;
+            switch (stmt->kind)
+            {
+            case STMT_DECLARATION:
+            {
+                DeclarationStmt *decl = static_cast<DeclarationStmt *>(stmt);
+                if (symbolTable.declaredInScope(decl->symbolId))
+                {
+                    report(decl->name.data(), "Error: Variable '" + string(decl->name) + "' already declared.");
+                }
+                else
+                {
+                    symbolTable.addSymbol(decl->symbolId, decl->name, decl->type);
+                    decl->entry = symbolTable.lookup(decl->symbolId);
+                }
+                if (decl->init != nullptr)
+                {
+                    checkExpression(decl->init);
+                }
+                break;
+            }
+            case STMT_ASSIGNMENT:
+            {
+                AssignmentStmt *assign = static_cast<AssignmentStmt *>(stmt);
+                bool declared = symbolTable.hasSymbol(assign->symbolId);
+                if (!declared)
+                {
+                    report(assign->name.data(), "Error: Variable '" + string(assign->name) + "' not declared.");
+                }
+                assign->entry = symbolTable.lookup(assign->symbolId);
+                checkExpression(assign->value);
+                string_view varType = declared ? symbolTable.getVariableType(assign->symbolId) : string_view();
+                if (declared && !isCompatibleType(varType, assign->value->type))
+                {
+                    string message = "Type error: Cannot assign ";
+                    if (assign->value->kind == EXPR_BINARY)
+                        message += string(typeName(assign->value->type)) + " expression";
+                    else
+                        message += "value '" + string(assign->value->text) + "'";
+                    report(assign->name.data(), message + " to variable of type '" + string(varType) + "'");
+                }
+                break;
+            }
+            case STMT_IF:
+            {
+                IfStmt *branch = static_cast<IfStmt *>(stmt);
+                checkExpression(branch->condition);
+                if (branch->elseBranch != nullptr)
+                {
+                    checkTasks.push_back(CheckTask{&branch->elseBranch, &branch->elseBranch + 1, nullptr, false});
+                }
+                checkTasks.push_back(CheckTask{&branch->thenBranch, &branch->thenBranch + 1, nullptr, false});
+                break;
+            }
+            case STMT_WHILE:
+            {
+                WhileStmt *loop = static_cast<WhileStmt *>(stmt);
+                checkExpression(loop->condition);
+                checkTasks.push_back(CheckTask{&loop->body, &loop->body + 1, nullptr, false});
+                break;
+            }
+            case STMT_FOR:
+            {
+                ForStmt *loop = static_cast<ForStmt *>(stmt);
+                checkTasks.push_back(CheckTask{&loop->body, &loop->body + 1, nullptr, false});
+                if (loop->step != nullptr)
+                {
+                    checkTasks.push_back(CheckTask{&loop->step, &loop->step + 1, nullptr, false});
+                }
+                checkStatement(loop->init);
+                checkExpression(loop->condition);
+                break;
+            }
+            case STMT_DO_WHILE:
+            {
+                DoWhileStmt *loop = static_cast<DoWhileStmt *>(stmt);
+                checkTasks.push_back(CheckTask{nullptr, nullptr, loop->condition, false});
+                checkTasks.push_back(CheckTask{&loop->body, &loop->body + 1, nullptr, false});
+                break;
+            }
+            case STMT_RETURN:
+                checkExpression(static_cast<ReturnStmt *>(stmt)->value);
+                break;
+            case STMT_BLOCK:
+            {
+                const NodeList<Stmt> &statements = static_cast<BlockStmt *>(stmt)->statements;
+                symbolTable.enterScope();
+                checkTasks.push_back(CheckTask{statements.begin(), statements.end(), nullptr, true});
+                break;
+            }
+            }
+        }
+    }
+
+    // Post-order, so a binary node is typed once both operands are. The
+    // walk runs down left operands, leaving binary nodes on the stack; a
+    // null above one marks that its right operand is under way.
+    void checkExpression(Expr *root)
+    {
+        vector<Expr *> &pending = pendingExpressions;
+        size_t base = pending.size();
+        Expr *expr = root;
+        while (true)
+        {
+            while (expr->kind == EXPR_BINARY)
+            {
+                pending.push_back(expr);
+                expr = static_cast<BinaryExpr *>(expr)->left;
+            }
+            if (expr->kind == EXPR_VARIABLE)
+            {
+                VariableExpr *variable = static_cast<VariableExpr *>(expr);
+                uint32_t symbolId = variable->symbolId;
+                if (!symbolTable.hasSymbol(symbolId))
+                {
+                    report(expr->text.data(), "Error: Variable '" + string(expr->text) + "' used but not declared.");
+                }
+                variable->entry = symbolTable.lookup(symbolId);
+                expr->type = variableType(symbolId);
+            }
+            while (pending.size() > base && pending.back() == nullptr)
+            {
+                pending.pop_back();
+                BinaryExpr *binary = static_cast<BinaryExpr *>(pending.back());
+                pending.pop_back();
+                binary->type = binaryType(binary->op, binary->left, binary->right);
+                if (binary->left->kind == EXPR_INT && binary->right->kind == EXPR_INT)
+                {
+                    // Only left unfolded when folding failed
+                    const char *problem = integerFoldError(binary->op, static_cast<ConstantExpr *>(binary->left)->value.intValue,
+                                                           static_cast<ConstantExpr *>(binary->right)->value.intValue);
+                    if (problem != nullptr)
+                    {
+                        report(binary->op.data(), "Error: " + string(problem) + " in constant expression.");
+                    }
+                }
+            }
+            if (pending.size() == base)
+            {
+                return;
+            }
+            expr = static_cast<BinaryExpr *>(pending.back())->right;
+            pending.push_back(nullptr);
+        }
+    }
+
+    // Lexical errors reach the parser as T_ERROR tokens; they are reported
+    // and skipped here so the grammar never sees them.
+    const Token &peek()
+    {
+        while (tokens.peek().type == T_ERROR)
+        {
+            Token bad = tokens.advance();
+            report(bad.value.data(), BasicLexer<Dialect>::describeError(bad.value));
+            syntaxErrors++;
+        }
+        return tokens.peek();
+    }
+
+    Token advance()
+    {
+        peek();
+        Token token = tokens.advance();
+        previousEnd = offsetOf(token) + token.value.size();
+        return token;
+    }
+
+    size_t offsetOf(const Token &token) const
+    {
+        return token.value.data() - source.data();
+    }
+
+    void report(const char *at, string message)
+    {
+        diagnostics.push_back(Diagnostic{static_cast<size_t>(at - source.data()), move(message)});
+    }
+
+    [[noreturn]] void syntaxError(const char *at, string message)
+    {
+        report(at, move(message));
+        syntaxErrors++;
+        throw SyntaxError();
+    }
+
+    // Panic-mode recovery: skips to just past the next ';', or past the '}'
+    // closing a block that opened after the error, or up to a '}' closing an
+    // enclosing block, which is left for that block to consume. A type
+    // keyword also stops it, so a missing ';' does not swallow the next
+    // declaration; every statement consumes its first token before it can
+    // fail, so this always makes progress. Returns true if it stopped at a
+    // '}' closing an enclosing block.
+    bool synchronize()
+    {
+        size_t depth = 0;
+        while (peek().type != T_EOF)
+        {
+            TokenTypeValue type = peek().type;
+            if (type == T_RBRACE && depth == 0)
+            {
+                return true;
+            }
+            if (depth == 0 && (type == T_INT || type == T_FLOAT || type == T_STRING || type == T_BOOL))
+            {
+                return false;
+            }
+            advance();
+            if (type == T_LBRACE)
+            {
+                depth++;
+            }
+            else if (type == T_RBRACE && --depth == 0)
+            {
+                return false;
+            }
+            else if (type == T_SEMICOLON && depth == 0)
+            {
+                return false;
+            }
+        }
         return false;
     }
 
-    bool isInteger(const string &value)
+    string describe(const Token &token)
+    {
+        return token.type == T_EOF ? "end of file" : string(token.value);
+    }
+
+    // All diagnostics go out in a single write so they do not interleave
+    // with the output of other sources compiling at the same time.
+    void printDiagnostics(ostream &errors)
+    {
+        ostringstream out;
+        for (const Diagnostic &diagnostic : diagnostics)
+        {
+            LineIndex::Position at = lines.locate(diagnostic.offset);
+            out << diagnostic.message << " on line no: " << at.line << ", column: " << at.column << "\n";
+        }
+        out << "Parsing failed with " << diagnostics.size() << " error(s)\n";
+        errors << out.str();
+    }
+
+    // Statements are parsed on an explicit stack of frames rather than by
+    // recursion, so nesting depth is limited only by memory. A frame is a
+    // statement whose own tokens have been read up to the point where it
+    // waits for a child statement: a block waits for its next item, an if
+    // for its branch, a loop for its body. A finished statement is handed
+    // to the frame on top until one is left over for the caller.
+    //
+    // A syntax error unwinds to the innermost open block, as the recursive
+    // parser did: the frames above it are dropped with their partial
+    // statements and the block synchronizes and carries on.
+    Stmt *parseStatement()
+    {
+        size_t base = frames.size();
+        while (true)
+        {
+            try
+            {
+                Stmt *done;
+                if (frames.size() > base && frames.back().kind == FRAME_BLOCK && (peek().type == T_RBRACE || peek().type == T_EOF))
+                {
+                    done = closeBlock();
+                }
+                else
+                {
+                    done = beginStatement();
+                }
+                while (done != nullptr)
+                {
+                    if (frames.size() == base)
+                    {
+                        return done;
+                    }
+                    done = finishFrame(done);
+                }
+            }
+            catch (const SyntaxError &)
+            {
+                while (frames.size() > base && frames.back().kind != FRAME_BLOCK)
+                {
+                    frames.pop_back();
+                }
+                if (frames.size() == base)
+                {
+                    throw;
+                }
+                synchronize();
+            }
+        }
+    }
+
+    // Parses a simple statement whole and returns it, or reads the head of
+    // a compound one, pushes its frames and returns null. The rule is
+    // picked by the statement's first token.
+    Stmt *beginStatement()
+    {
+        return (this->*STATEMENT_RULES.of[peek().type])();
+    }
+
+    [[noreturn]] Stmt *unexpectedStatement()
+    {
+        syntaxError(peek().value.data(), "Syntax error: unexpected token " + describe(peek()));
+    }
+
+    // Gives a finished child statement to the frame on top. Returns the
+    // statement that completes, if the frame is done with.
+    Stmt *finishFrame(Stmt *child)
+    {
+        Frame &frame = frames.back();
+        switch (frame.kind)
+        {
+        case FRAME_BLOCK:
+            blockItems.push_back(child);
+            return nullptr;
+        case FRAME_IF_THEN:
+        {
+            Expr *condition = frame.condition;
+            frames.pop_back();
+            if (peek().type == T_ELSE)
+            {
+                expect(T_ELSE);
+                frames.push_back(Frame{FRAME_IF_ELSE, condition, child, nullptr, 0});
+                return nullptr;
+            }
+            return arena.make<IfStmt>(Stmt{STMT_IF}, condition, child, nullptr);
+        }
+        case FRAME_IF_ELSE:
+        {
+            Stmt *result = arena.make<IfStmt>(Stmt{STMT_IF}, frame.condition, frame.first, child);
+            frames.pop_back();
+            return result;
+        }
+        case FRAME_WHILE:
+        {
+            Stmt *result = arena.make<WhileStmt>(Stmt{STMT_WHILE}, frame.condition, child);
+            frames.pop_back();
+            return result;
+        }
+        case FRAME_FOR:
+        {
+            Stmt *result = arena.make<ForStmt>(Stmt{STMT_FOR}, frame.first, frame.condition, frame.second, child);
+            frames.pop_back();
+            return result;
+        }
+        case FRAME_DO:
+            frames.pop_back();
+            return finishDoWhileLoop(child);
+        }
+        return nullptr;
+    }
+
+    Stmt *beginDoWhileLoop()
+    {
+        expect(T_DO); // Expect 'do'
+
+        expect(T_LBRACE); // Expect '{'
+        frames.push_back(Frame{FRAME_DO, nullptr, nullptr, nullptr, 0});
+        return beginBlock(); // The body block
+    }
+
+    Stmt *finishDoWhileLoop(Stmt *body)
+    {
+        expect(T_RBRACE); // Expect '}'
+
+        expect(T_WHILE);  // Expect 'while'
+        expect(T_LPAREN); // Expect '(' for condition
+
+        Expr *condition = parseCondition(); // Parse the condition
+        expect(T_RPAREN);                   // Expect ')' after condition
+        expect(T_SEMICOLON);                // Expect ';'
+
+        return arena.make<DoWhileStmt>(Stmt{STMT_DO_WHILE}, body, condition);
+    }
+
+    // The items of every open block share blockItems; each block's run
+    // starts at its frame's blockStart.
+    Stmt *beginBlock()
+    {
+        expect(T_LBRACE);
+        frames.push_back(Frame{FRAME_BLOCK, nullptr, nullptr, nullptr, blockItems.size()});
+        return nullptr;
+    }
+
+    Stmt *closeBlock()
+    {
+        size_t start = frames.back().blockStart;
+        frames.pop_back();
+        NodeList<Stmt> statements = NodeList<Stmt>::copy(arena, blockItems.data() + start, blockItems.data() + blockItems.size());
+        blockItems.resize(start);
+        expect(T_RBRACE);
+        return arena.make<BlockStmt>(Stmt{STMT_BLOCK}, statements);
+    }
+
+    Stmt *parseDeclaration()
+    {
+        Token typeToken = advance();
+        Token idToken = advance();
+
+        if (idToken.type != T_ID)
+        {
+            syntaxError(idToken.value.data(), "Syntax error: Expected identifier");
+        }
+
+        Expr *init = nullptr;
+        if (peek().type == T_ASSIGN)
+        {
+            advance(); // Consume '='
+            init = parseExpression();
+        }
+
+        if (peek().type != T_SEMICOLON)
+        {
+            syntaxError(peek().value.data(), "Syntax error: Expected ';' after declaration.");
+        }
+
+        expect(T_SEMICOLON);
+        return arena.make<DeclarationStmt>(Stmt{STMT_DECLARATION}, idToken.value, idToken.symbolId, typeToken.value, init,
+                                           SymbolTable::NO_ENTRY);
+    }
+    Stmt *parseAssignment()
+    {
+        Token varToken = advance();
+        expect(T_ASSIGN);
+        Expr *value = parseExpression();
+        expect(T_SEMICOLON);
+        return arena.make<AssignmentStmt>(Stmt{STMT_ASSIGNMENT}, varToken.value, varToken.symbolId, value, SymbolTable::NO_ENTRY);
+    }
+
+    // Ints and floats mix as numbers, and a bool may be stored in an int.
+    bool isCompatibleType(string_view varType, ValueType valueType)
     {
-        return !value.empty() && all_of(value.begin(), value.end(), ::isdigit);
+        switch (valueTypeOf(varType))
+        {
+        case TYPE_INT:
+            return valueType == TYPE_INT || valueType == TYPE_BOOL;
+        case TYPE_FLOAT:
+            return valueType == TYPE_INT || valueType == TYPE_FLOAT;
+        case TYPE_BOOL:
+            return valueType == TYPE_BOOL;
+        case TYPE_STRING:
+            return valueType == TYPE_STRING;
+        }
+        return false;
     }
 
-    bool isFloat(const string &value)
+    // Arithmetic is float if either side is; everything else is a comparison
+    // or a logical operator and yields a bool.
+    static ValueType binaryType(string_view op, const Expr *left, const Expr *right)
     {
-        bool hasDecimal = false;
-        for (char c : value)
+        if (op == "+" || op == "-" || op == "*" || op == "/")
         {
-            if (c == '.')
-            {
-                if (hasDecimal)
-                    return false; // Multiple decimals
-                hasDecimal = true;
-            }
-            else if (!isdigit(c))
-            {
-                return false; // Non-numeric characters
-            }
+            return left->type == TYPE_FLOAT || right->type == TYPE_FLOAT ? TYPE_FLOAT : TYPE_INT;
         }
-        return hasDecimal; // Must contain one decimal point
+        return TYPE_BOOL;
     }
-    bool isStringLiteral(const string &value)
+
+    ValueType variableType(uint32_t symbolId)
     {
-        return value.size() >= 2 && value.front() == '"' && value.back() == '"';
+        return symbolTable.hasSymbol(symbolId) ? valueTypeOf(symbolTable.getVariableType(symbolId)) : TYPE_INT;
     }
 
-    void parseForLoop()
+    Stmt *beginForLoop()
     {
         expect(T_FOR);
         expect(T_LPAREN);
-        parseAssignment();
-        string condition = parseExpression();
+        Stmt *init = parseAssignment();
+        Expr *condition = parseExpression();
         expect(T_SEMICOLON);
-        string increment = parseIncrement();
+        Stmt *step = parseIncrement();
         expect(T_RPAREN);
-        parseBlock();
+        frames.push_back(Frame{FRAME_FOR, condition, init, step, 0});
+        return beginBlock();
     }
 
-    string parseIncrement()
+    // The step of a for loop: "x = expression" or "x + number" / "x - number",
+    // which adds to x in place. Returns null for a step with no effect.
+    Stmt *parseIncrement()
     {
-        string varName = tokens[pos].value;
+        Token varToken = peek();
         expect(T_ID);
 
-        if (tokens[pos].type == T_ASSIGN)
+        if (peek().type == T_ASSIGN)
         {
             expect(T_ASSIGN);
-            string value = parseExpression();
-            tacGen.generateAssign(varName, value);
+            Expr *value = parseExpression();
+            return arena.make<AssignmentStmt>(Stmt{STMT_ASSIGNMENT}, varToken.value, varToken.symbolId, value, SymbolTable::NO_ENTRY);
         }
-        else if (tokens[pos].type == T_PLUS || tokens[pos].type == T_MINUS)
+        else if (peek().type == T_PLUS || peek().type == T_MINUS)
         {
-            string op = tokens[pos].value;
-            pos++;
-            if (tokens[pos].type == T_NUM)
+            string_view op = peek().value;
+            advance();
+            if (isNumericLiteral(peek().type))
             {
-                string incrementAmount = tokens[pos].value;
-                expect(T_NUM);
-                string tempVar = "t" + to_string(tempCount++);
-                tacGen.generate(op, varName, incrementAmount, tempVar);
-                tacGen.generateAssign(varName, tempVar);
+                Expr *variable = arena.make<VariableExpr>(Expr{EXPR_VARIABLE, TYPE_INT, varToken.value}, varToken.symbolId,
+                                                           SymbolTable::NO_ENTRY);
+                Expr *amount = parseFactor();
+                Expr *sum = arena.make<BinaryExpr>(Expr{EXPR_BINARY, binaryType(op, variable, amount), string_view()}, op, variable, amount);
+                return arena.make<AssignmentStmt>(Stmt{STMT_ASSIGNMENT}, varToken.value, varToken.symbolId, sum, SymbolTable::NO_ENTRY);
             }
+            return nullptr;
         }
         else
         {
-            cout << "Syntax error: expected increment expression but found " << tokens[pos].value << endl;
-            exit(1);
+            syntaxError(peek().value.data(), "Syntax error: expected increment expression but found " + describe(peek()));
         }
-
-        return varName; // Return the incremented variable
     }
-    void parseWhileLoop()
+    Stmt *beginWhileLoop()
     {
         expect(T_WHILE);
         expect(T_LPAREN);
-        string condition = parseExpression(); // Condition
+        Expr *condition = parseExpression(); // Condition
         expect(T_RPAREN);
-        parseBlock();
+        frames.push_back(Frame{FRAME_WHILE, condition, nullptr, nullptr, 0});
+        return beginBlock();
     }
 
-    void parseIfStatement()
+    // The then branch is any statement; an else, if one follows it, is
+    // taken when the branch is handed back.
+    Stmt *beginIfStatement()
     {
         expect(T_IF);
         expect(T_LPAREN);
-        string condition = parseCondition();
+        Expr *condition = parseCondition();
         expect(T_RPAREN);
-        parseStatement();
-        if (tokens[pos].type == T_ELSE)
-        {
-            expect(T_ELSE);
-            parseStatement();
-        }
+        frames.push_back(Frame{FRAME_IF_THEN, condition, nullptr, nullptr, 0});
+        return nullptr;
     }
 
-    string parseCondition()
+    Expr *parseCondition()
     {
-        string left = parseExpression();
+        Expr *left = parseExpression();
 
-        // Check for the supported relational operators
-        if (tokens[pos].type == T_GT || tokens[pos].type == T_LT ||
-            tokens[pos].type == T_ASSIGN || tokens[pos].type == T_EQ ||
-            tokens[pos].type == T_LE || tokens[pos].type == T_GE ||
-            tokens[pos].type == T_NEQ)
+        // parseExpression has taken every comparison already; a condition
+        // may also compare with a single '='
+        if (peek().type == T_ASSIGN)
         {
-            string op = tokens[pos++].value;        // Consume the operator
-            string right = parseExpression();       // Parse the right-hand side expression
-            string temp = generateTemp();           // Generate a temporary variable for the result
-            tacGen.generate(op, left, right, temp); // Generate the TAC for the comparison
-            return temp;                            // Return the temporary result variable
+            string_view op = advance().value; // Consume the operator
+            Expr *right = parseExpression();         // Parse the right-hand side expression
+            // A comparison is never folded; it always gets a temporary
+            return arena.make<BinaryExpr>(Expr{EXPR_BINARY, TYPE_BOOL, string_view()}, op, left, right);
         }
 
         return left; // Return the left expression if no relational operator is found
     }
 
-    string generateTemp()
-    {
-        return "t" + to_string(tempCount++);
-    }
-
-    void parseReturnStatement()
+    Stmt *parseReturnStatement()
     {
         expect(T_RETURN);
-        string returnValue = parseExpression();
-        tacGen.generateAssign("return_value", returnValue);
+        Expr *returnValue = parseExpression();
         expect(T_SEMICOLON);
+        return arena.make<ReturnStmt>(Stmt{STMT_RETURN}, returnValue);
     }
 
-    // string parseExpression()
-    // {
-    //     string result = parseRelational();
-    //     while (tokens[pos].type == T_PLUS || tokens[pos].type == T_MINUS)
-    //     {
-    //         string op = tokens[pos].value;
-    //         pos++;
-    //         string arg2 = parseRelational();
-    //         string tempVar = "t" + to_string(tempCount++);
-    //         tacGen.generate(op, result, arg2, tempVar);
-    //         result = tempVar;
-    //     }
-    //     return result;
-    // }
-
-    string parseExpression()
+    // Precedence climbing with explicit stacks: operands, and operators
+    // still waiting for their right operand, are kept in vectors instead of
+    // nested calls. An operator first reduces every waiting one that binds
+    // at least as tightly, which keeps operators left-associative and builds
+    // the same tree as the recursive form. A '(' waits on the operator
+    // stack as a marker of power 0 that nothing reduces past.
+    Expr *parseExpression()
     {
-        string result = parseRelational();
-        while (tokens[pos].type == T_PLUS || tokens[pos].type == T_MINUS)
+        operands.clear();
+        operators.clear();
+        size_t openParens = 0;
+        while (true)
         {
-            string op = tokens[pos].value;
-            pos++;
-            string arg2 = parseRelational();
+            while (peek().type == T_LPAREN)
+            {
+                advance();
+                operators.push_back(PendingOperator{string_view(), 0});
+                openParens++;
+            }
+            operands.push_back(parseFactor());
 
-            if (isConstant(result) && isConstant(arg2))
+            uint8_t power;
+            while ((power = BINDING_POWER<Dialect>.of[peek().type]) == 0 && peek().type == T_RPAREN && openParens > 0)
             {
-                result = performConstantFolding(result, arg2, op);
+                reduceOperators(1);
+                operators.pop_back();
+                openParens--;
+                advance();
             }
-            else
+            if (power == 0)
             {
-                string tempVar = "t" + to_string(tempCount++);
-                tacGen.generate(op, result, arg2, tempVar);
-                result = tempVar;
+                break;
             }
+            reduceOperators(power);
+            operators.push_back(PendingOperator{advance().value, power});
         }
-        return result;
+        if (openParens > 0)
+        {
+            expect(T_RPAREN);
+        }
+        reduceOperators(1);
+        return operands.back();
+    }
+
+    // Applies waiting operators that bind at least as tightly as minPower.
+    void reduceOperators(uint8_t minPower)
+    {
+        while (!operators.empty() && operators.back().power >= minPower)
+        {
+            string_view op = operators.back().op;
+            operators.pop_back();
+            Expr *right = operands.back();
+            operands.pop_back();
+            operands.back() = makeBinary(op, operands.back(), right);
+        }
+    }
+
+    // Builds left op right, folding it to a constant when both sides are.
+    Expr *makeBinary(string_view op, Expr *left, Expr *right)
+    {
+        if (left->isConstant() && right->isConstant())
+        {
+            return performConstantFolding(static_cast<ConstantExpr *>(left), static_cast<ConstantExpr *>(right), op);
+        }
+        return arena.make<BinaryExpr>(Expr{EXPR_BINARY, binaryType(op, left, right), string_view()}, op, left, right);
+    }
+
+    // Why op cannot be folded over the integer constants left and right in
+    // int64_t, or nullptr if it can.
+    static const char *integerFoldError(string_view op, int64_t left, int64_t right)
+    {
+        int64_t result;
+        if ((op == "+" && __builtin_add_overflow(left, right, &result)) ||
+            (op == "-" && __builtin_sub_overflow(left, right, &result)) ||
+            (op == "*" && __builtin_mul_overflow(left, right, &result)) ||
+            (op == "/" && left == INT64_MIN && right == -1))
+        {
+            return "integer overflow";
+        }
+        if (op == "/" && right == 0)
+        {
+            return "division by zero";
+        }
+        return nullptr;
+    }
+
+    // op over integer constants that integerFoldError has accepted.
+    static int64_t foldIntegers(string_view op, int64_t left, int64_t right)
+    {
+        if (op == "+")
+            return left + right;
+        else if (op == "-")
+            return left - right;
+        else if (op == "*")
+            return left * right;
+        else if (op == "/")
+            return left / right;
+        else if (op == "<")
+            return left < right;
+        else if (op == ">")
+            return left > right;
+        else if (op == "<=")
+            return left <= right;
+        else if (op == ">=")
+            return left >= right;
+        else if (op == "==")
+            return left == right;
+        else if (op == "!=")
+            return left != right;
+        else if (op == "&&")
+            return left != 0 && right != 0;
+        else if (op == "||")
+            return left != 0 || right != 0;
+        return 0;
     }
 
-    bool isConstant(const string &value)
+    Expr *makeIntConstant(int64_t value, ValueType type)
     {
-        return isInteger(value) || isFloat(value);
+        return arena.make<ConstantExpr>(Expr{EXPR_INT, type, arena.copy(to_string(value))}, NumericLiteral{.intValue = value});
     }
 
-    string performConstantFolding(const string &left, const string &right, const string &op)
+    Expr *performConstantFolding(const ConstantExpr *left, const ConstantExpr *right, string_view op)
     {
-        bool leftIsInt = isInteger(left);
-        bool rightIsInt = isInteger(right);
-        double leftVal = isInteger(left) ? stod(left) : stod(left);
-        double rightVal = isInteger(right) ? stod(right) : stod(right);
+        ValueType type = binaryType(op, left, right);
+        if (left->kind == EXPR_INT && right->kind == EXPR_INT)
+        {
+            // Integers fold exactly in int64_t. Overflow and division by
+            // zero are left unfolded for the semantic checks to report, and
+            // a division with a remainder folds to a float as before.
+            int64_t leftVal = left->value.intValue;
+            int64_t rightVal = right->value.intValue;
+            if (integerFoldError(op, leftVal, rightVal) != nullptr)
+            {
+                return arena.make<BinaryExpr>(Expr{EXPR_BINARY, type, string_view()}, op, const_cast<ConstantExpr *>(left),
+                                              const_cast<ConstantExpr *>(right));
+            }
+            if (op != "/" || leftVal % rightVal == 0)
+            {
+                return makeIntConstant(foldIntegers(op, leftVal, rightVal), type);
+            }
+        }
+
+        double leftVal = left->asDouble();
+        double rightVal = right->asDouble();
         double resultVal = 0.0;
 
         if (op == "+")
@@ -880,125 +3835,621 @@ private:
             resultVal = leftVal * rightVal;
         else if (op == "/")
             resultVal = leftVal / rightVal;
+        else if (op == "<")
+            resultVal = leftVal < rightVal;
+        else if (op == ">")
+            resultVal = leftVal > rightVal;
+        else if (op == "<=")
+            resultVal = leftVal <= rightVal;
+        else if (op == ">=")
+            resultVal = leftVal >= rightVal;
+        else if (op == "==")
+            resultVal = leftVal == rightVal;
+        else if (op == "!=")
+            resultVal = leftVal != rightVal;
+        else if (op == "&&")
+            resultVal = leftVal != 0 && rightVal != 0;
+        else if (op == "||")
+            resultVal = leftVal != 0 || rightVal != 0;
+
+        if (type == TYPE_BOOL)
+        {
+            // A comparison or logical operator yields 0 or 1
+            return makeIntConstant(resultVal != 0, TYPE_BOOL);
+        }
+        return arena.make<ConstantExpr>(Expr{EXPR_FLOAT, TYPE_FLOAT, arena.copy(to_string(resultVal))}, NumericLiteral{.floatValue = resultVal});
+    }
 
-        // Return the computed result as a string, while maintaining the type precision
-        // Convert to string with the appropriate type handling:
-        if (leftIsInt && rightIsInt && resultVal == static_cast<int>(resultVal))
+    // A single operand; parseExpression deals with parentheses.
+    Expr *parseFactor()
+    {
+        if (peek().type == T_ID)
+        {
+            // The variable's type is filled in by the semantic checks
+            Token idToken = advance();
+            return arena.make<VariableExpr>(Expr{EXPR_VARIABLE, TYPE_INT, idToken.value}, idToken.symbolId, SymbolTable::NO_ENTRY);
+        }
+        if (peek().type == T_NUM)
         {
-            // If the result is effectively an integer, return it as an integer
-            return to_string(static_cast<int>(resultVal));
+            Token number = advance();
+            return arena.make<ConstantExpr>(Expr{EXPR_INT, TYPE_INT, number.value}, number.literal);
+        }
+        if (peek().type == T_FLOAT_LITERAL)
+        {
+            Token number = advance();
+            return arena.make<ConstantExpr>(Expr{EXPR_FLOAT, TYPE_FLOAT, number.value}, number.literal);
+        }
+        if (peek().type == T_BOOL_LITERAL || peek().type == T_STRING_LITERAL)
+        {
+            Token literal = advance();
+            return arena.make<Expr>(EXPR_LITERAL, literal.type == T_BOOL_LITERAL ? TYPE_BOOL : TYPE_STRING, literal.value);
         }
         else
         {
-            // Otherwise, return as a float string
-            return to_string(resultVal);
+            syntaxError(peek().value.data(), "Syntax error: unexpected token " + describe(peek()));
         }
     }
 
-    string parseRelational()
+    void expect(TokenTypeValue type)
     {
-        string result = parseTerm();
-
-        while (tokens[pos].type == T_GT || tokens[pos].type == T_LT || tokens[pos].type == T_EQ ||
-               tokens[pos].type == T_NEQ || tokens[pos].type == T_LE || tokens[pos].type == T_GE)
+        if (peek().type == type)
+        {
+            advance();
+        }
+        else
         {
-            string op = tokens[pos].value;
-            pos++;
-            string arg2 = parseTerm();
+            syntaxError(peek().value.data(), "Syntax error: expected " + string(TOKEN_NAME<Dialect>.of[type]) + " but found " + describe(peek()));
+        }
+    }
+};
 
-            if (isConstant(result) && isConstant(arg2))
+template <typename Dialect>
+constexpr typename BasicParser<Dialect>::StatementRuleTable BasicParser<Dialect>::STATEMENT_RULES;
+
+using Parser = BasicParser<EnglishDialect>;
+
+// Read-only mapping of a source file. The Lexer views the mapped bytes
+// directly, so the file is never copied into a string.
+class MappedFile
+{
+public:
+    MappedFile(const string &path) : path(path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            size = st.st_size;
+            opened = true;
+            if (size > 0)
             {
-                result = performConstantFolding(result, arg2, op);
+                void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED)
+                {
+                    opened = false;
+                    size = 0;
+                }
+                else
+                {
+                    data = static_cast<const char *>(mapped);
+                    madvise(mapped, size, MADV_SEQUENTIAL);
+                }
             }
-            else
+        }
+        close(fd);
+    }
+
+    MappedFile(MappedFile &&other) noexcept
+        : path(move(other.path)), data(other.data), size(other.size), opened(other.opened)
+    {
+        other.data = nullptr;
+        other.size = 0;
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        if (data != nullptr)
+        {
+            munmap(const_cast<char *>(data), size);
+        }
+    }
+
+    bool isOpen() const { return opened; }
+    const string &getPath() const { return path; }
+    string_view view() const { return string_view(data, size); }
+
+private:
+    string path;
+    const char *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+};
+
+// 64-bit hash of a whole source, eight bytes per step; it keys the token
+// cache, so it only has to be fast and well mixed, not cryptographic.
+uint64_t hashSource(string_view src)
+{
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = src.size() * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= src.size(); i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, src.data() + i, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    if (i < src.size())
+    {
+        memcpy(&tail, src.data() + i, src.size() - i);
+    }
+    hash = (hash ^ tail) * multiplier;
+    return hash ^ (hash >> 32);
+}
+
+// On-disk cache of lexed token streams, one file per source named after the
+// source's hash. An entry is a fixed header followed by the identifier names
+// and the tokens, all as LEB128 varints:
+//
+//   header  magic, version, source hash, source size, name and token counts
+//   names   offset, length                 (views into the source)
+//   tokens  kind byte, gap since the end of the previous token, then
+//           T_ID              name index
+//           T_NUM             length, value
+//           T_FLOAT_LITERAL   length, 8 raw bytes of the double
+//           anything else     length
+//
+// A typical token takes three bytes. Entries are written to a temporary
+// file and renamed into place, so concurrent compilers never see half an
+// entry; an entry that fails any check on load is ignored and relexed.
+class TokenCache
+{
+public:
+    TokenCache(string directory) : directory(move(directory)) {}
+
+    string entryPath(uint64_t hash) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.tok", static_cast<unsigned long long>(hash));
+        return directory + name;
+    }
+
+    // Fills tokens with the cached tokens of source, interning identifiers
+    // into pool. Returns false when there is no valid entry.
+    bool load(string_view source, uint64_t hash, StringPool &pool, TokenStore &tokens) const
+    {
+        MappedFile entry(entryPath(hash));
+        return entry.isOpen() && decode(entry.view(), source, hash, pool, tokens);
+    }
+
+    bool save(const TokenStore &tokens, const StringPool &pool, uint64_t hash) const
+    {
+        string bytes;
+        if (!encode(tokens, pool, hash, bytes))
+        {
+            return false;
+        }
+        static atomic<unsigned> saves{0};
+        string path = entryPath(hash);
+        string temp = path + "." + to_string(getpid()) + "." + to_string(saves++) + ".tmp";
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        size_t written = 0;
+        while (written < bytes.size())
+        {
+            ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+            if (n <= 0)
             {
-                string tempVar = "t" + to_string(tempCount++);
-                tacGen.generate(op, result, arg2, tempVar);
-                result = tempVar;
+                break;
             }
+            written += n;
         }
-        return result;
+        close(fd);
+        if (written != bytes.size() || rename(temp.c_str(), path.c_str()) != 0)
+        {
+            unlink(temp.c_str());
+            return false;
+        }
+        return true;
     }
 
-    string parseTerm()
+    // Serialises tokens into out. Fails if an interned name does not view
+    // tokens.source(), which only happens for pools shared across buffers.
+    static bool encode(const TokenStore &tokens, const StringPool &pool, uint64_t hash, string &out)
     {
-        string result = parseFactor();
-        while (tokens[pos].type == T_MUL || tokens[pos].type == T_DIV)
+        string_view src = tokens.source();
+        Header header{{'F', 'C', 'T', 'K'}, VERSION, hash, src.size(), pool.size(), tokens.size()};
+        out.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (uint32_t id = 0; id < pool.size(); id++)
         {
-            string op = tokens[pos].value;
-            pos++;
-            string arg2 = parseFactor();
-
-            if (isConstant(result) && isConstant(arg2))
+            string_view name = pool.name(id);
+            if (name.data() < src.data() || name.data() + name.size() > src.data() + src.size())
+            {
+                return false;
+            }
+            putVarint(out, name.data() - src.data());
+            putVarint(out, name.size());
+        }
+        size_t previousEnd = 0;
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            TokenTypeValue kind = tokens.kind(i);
+            out.push_back(static_cast<char>(kind));
+            putVarint(out, tokens.offset(i) - previousEnd);
+            if (kind == T_ID)
             {
-                result = performConstantFolding(result, arg2, op);
+                putVarint(out, tokens.symbolId(i));
             }
             else
             {
-                string tempVar = "t" + to_string(tempCount++);
-                tacGen.generate(op, result, arg2, tempVar);
-                result = tempVar;
+                putVarint(out, tokens.value(i).size());
+            }
+            if (kind == T_NUM)
+            {
+                putVarint(out, tokens.literal(i).intValue);
+            }
+            else if (kind == T_FLOAT_LITERAL)
+            {
+                double value = tokens.literal(i).floatValue;
+                out.append(reinterpret_cast<const char *>(&value), sizeof(value));
             }
+            previousEnd = tokens.end(i);
         }
-        return result;
+        return true;
     }
 
-    string parseFactor()
+    static bool decode(string_view bytes, string_view source, uint64_t hash, StringPool &pool, TokenStore &tokens)
     {
-        if (tokens[pos].type == T_NUM || tokens[pos].type == T_FLOAT_LITERAL || tokens[pos].type == T_BOOL_LITERAL || tokens[pos].type == T_STRING_LITERAL || tokens[pos].type == T_ID)
+        Header header;
+        if (bytes.size() < sizeof(header))
         {
-            return tokens[pos++].value;
+            return false;
         }
-        else if (tokens[pos].type == T_LPAREN)
+        memcpy(&header, bytes.data(), sizeof(header));
+        if (memcmp(header.magic, "FCTK", 4) != 0 || header.version != VERSION ||
+            header.sourceHash != hash || header.sourceSize != source.size())
         {
-            expect(T_LPAREN);
-            string result = parseExpression();
-            expect(T_RPAREN);
-            return result;
+            return false;
         }
-        else
+
+        Reader in{bytes.data() + sizeof(header), bytes.data() + bytes.size()};
+        vector<uint32_t> remap;
+        remap.reserve(min<uint64_t>(header.nameCount, bytes.size()));
+        pool.reserve(pool.size() + remap.capacity());
+        for (uint64_t id = 0; id < header.nameCount; id++)
+        {
+            uint64_t offset, length;
+            if (!in.varint(offset) || !in.varint(length) || offset > source.size() || length > source.size() - offset)
+            {
+                return false;
+            }
+            remap.push_back(pool.intern(source.substr(offset, length)));
+        }
+
+        TokenStore decoded(source);
+        decoded.reserve(min<uint64_t>(header.tokenCount, bytes.size()));
+        size_t previousEnd = 0;
+        for (uint64_t i = 0; i < header.tokenCount; i++)
+        {
+            uint64_t gap, size;
+            if (in.at == in.end || static_cast<uint8_t>(*in.at) >= TOKEN_TYPE_COUNT)
+            {
+                return false;
+            }
+            Token token{static_cast<TokenTypeValue>(*in.at++), NO_SYMBOL, string_view()};
+            if (!in.varint(gap) || !in.varint(size))
+            {
+                return false;
+            }
+            if (token.type == T_ID)
+            {
+                if (size >= remap.size())
+                {
+                    return false;
+                }
+                token.symbolId = remap[size];
+                size = pool.name(token.symbolId).size();
+            }
+            if (gap > source.size() - previousEnd || size > source.size() - previousEnd - gap)
+            {
+                return false;
+            }
+            token.value = source.substr(previousEnd + gap, size);
+            if (token.type == T_NUM)
+            {
+                uint64_t value;
+                if (!in.varint(value))
+                {
+                    return false;
+                }
+                token.literal.intValue = static_cast<int64_t>(value);
+            }
+            else if (token.type == T_FLOAT_LITERAL)
+            {
+                if (in.end - in.at < static_cast<ptrdiff_t>(sizeof(double)))
+                {
+                    return false;
+                }
+                memcpy(&token.literal.floatValue, in.at, sizeof(double));
+                in.at += sizeof(double);
+            }
+            decoded.push(token);
+            previousEnd += gap + size;
+        }
+        if (in.at != in.end || decoded.size() == 0 || decoded.kind(decoded.size() - 1) != T_EOF)
         {
-            cout << "Syntax error: unexpected token " << tokens[pos].value << endl;
-            exit(1);
+            return false;
         }
+        tokens = move(decoded);
+        return true;
     }
 
-    void expect(TokenTypeValue type)
+private:
+    static const uint32_t VERSION = 1;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint64_t nameCount;
+        uint64_t tokenCount;
+    };
+
+    struct Reader
     {
-        if (tokens[pos].type == type)
+        const char *at;
+        const char *end;
+
+        bool varint(uint64_t &value)
         {
-            pos++;
+            value = 0;
+            for (int shift = 0; shift < 64 && at < end; shift += 7)
+            {
+                uint8_t byte = static_cast<uint8_t>(*at++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
         }
-        else
+    };
+
+    static void putVarint(string &out, uint64_t value)
+    {
+        while (value >= 0x80)
         {
-            cout << "Syntax error: expected " << tokenMap[type] << " but found " << tokens[pos].value << " on line no: " << tokens[pos].lineNo << endl;
-            exit(1);
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
         }
+        out.push_back(static_cast<char>(value));
     }
+
+    string directory;
+};
+
+// A lexer thread either feeds its parser through a TokenRing while the
+// parser runs, or, when lexing is split across several threads or a token
+// cache is in use, produces the whole token stream before the parser starts.
+struct LexJob
+{
+    string_view source;
+    size_t threads;
+    TokenRing *ring;
+    const TokenCache *cache;
+    TokenStore tokens;
+    StringPool pool;
 };
+
+template <typename Dialect>
 void *lexerThread(void *arg)
 {
     cout << "Lexer thread started" << endl;
-    Lexer *lexer = (Lexer *)arg;
-    lexer->tokenize();
+    LexJob *job = (LexJob *)arg;
+    if (job->ring != nullptr)
+    {
+        BasicLexer<Dialect> lexer(job->source, job->pool);
+        produceTokens(lexer, *job->ring);
+    }
+    else if (job->cache != nullptr)
+    {
+        // Tokens depend on the dialect's keywords as well as the source
+        uint64_t hash = hashSource(job->source) ^ hashSource(Dialect::NAME);
+        if (!job->cache->load(job->source, hash, job->pool, job->tokens))
+        {
+            job->tokens = tokenizeParallel<Dialect>(job->source, job->pool, job->threads);
+            job->cache->save(job->tokens, job->pool, hash);
+        }
+    }
+    else
+    {
+        job->tokens = tokenizeParallel<Dialect>(job->source, job->pool, job->threads);
+    }
     cout << "Lexer thread finished" << endl;
     cout << "---------------------------" << endl;
     pthread_exit(NULL);
 }
 
+// A parser thread renders its source's listing and diagnostics into
+// buffers, which compileSources prints in command-line order once every
+// thread has finished, so listings of different sources never interleave.
+template <typename Dialect>
+struct ParseJob
+{
+    BasicParser<Dialect> *parser;
+    ostringstream listing;
+    ostringstream errors;
+};
+
+template <typename Dialect>
 void *parserThread(void *arg)
 {
     cout << "Parser thread started" << endl;
-    Parser *parser = (Parser *)arg;
-    parser->parseProgram();
+    ParseJob<Dialect> *job = (ParseJob<Dialect> *)arg;
+    job->parser->parseProgram(job->listing, job->errors);
     cout << "Parser thread finished" << endl;
     cout << "---------------------------" << endl;
 
     pthread_exit(NULL);
 }
 
-int main()
+template <typename Dialect = EnglishDialect>
+int compileSources(const vector<string_view> &sources, const vector<string> &names, size_t lexThreads = 1,
+                   const TokenCache *cache = nullptr, size_t parseThreads = 1)
+{
+    // With a single lexing thread per source the lexer and parser run as a
+    // pipeline; parallel lexing, the token cache and parallel parsing need
+    // the whole token stream before parsing starts.
+    bool pipelined = lexThreads <= 1 && cache == nullptr && parseThreads <= 1;
+    vector<LexJob> jobs(sources.size());
+    vector<unique_ptr<TokenRing>> rings;
+    vector<TACGenerator> tacGens(sources.size());
+    vector<BasicParser<Dialect>> parsers;
+    parsers.reserve(sources.size());
+
+    vector<pthread_t> lexerTids(sources.size()), parserTids(sources.size());
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        jobs[i].source = sources[i];
+        jobs[i].threads = lexThreads;
+        jobs[i].ring = nullptr;
+        jobs[i].cache = cache;
+        if (pipelined)
+        {
+            rings.push_back(make_unique<TokenRing>());
+            jobs[i].ring = rings.back().get();
+            parsers.emplace_back(sources[i], TokenStream(*rings.back()), tacGens[i]);
+        }
+        pthread_create(&lexerTids[i], NULL, lexerThread<Dialect>, &jobs[i]);
+    }
+
+    if (!pipelined)
+    {
+        // Wait for lexer threads to finish
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            pthread_join(lexerTids[i], NULL);
+            parsers.emplace_back(sources[i], TokenStream(move(jobs[i].tokens)), tacGens[i]);
+            parsers.back().setParseThreads(parseThreads);
+        }
+    }
+
+    // Create parser threads for all inputs
+    vector<ParseJob<Dialect>> parseJobs(sources.size());
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        parseJobs[i].parser = &parsers[i];
+        pthread_create(&parserTids[i], NULL, parserThread<Dialect>, &parseJobs[i]);
+    }
+
+    // Wait for parser (and, when pipelined, lexer) threads to finish. A
+    // source with errors does not stop the others; the run fails at the end.
+    int status = 0;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        pthread_join(parserTids[i], NULL);
+        if (pipelined)
+        {
+            pthread_join(lexerTids[i], NULL);
+        }
+        if (!parsers[i].getDiagnostics().empty())
+        {
+            status = 1;
+        }
+    }
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        string header = "==> " + names[i] + " <==\n";
+        cout << header << parseJobs[i].listing.str() << flush;
+        if (!parsers[i].getDiagnostics().empty())
+        {
+            cerr << header << parseJobs[i].errors.str();
+        }
+    }
+    return status;
+}
+
+#ifndef FINAL_COMPILER_NO_MAIN
+// Usage: FinalCompiler [--lex-threads=N] [--parse-threads=N] [--token-cache=DIR]
+//                      [--dialect=english|urdu] [file...]
+// With no files the built-in sample programs are compiled. --token-cache
+// reuses token streams lexed by earlier runs from DIR, which must exist.
+// --parse-threads splits large programs into runs of top-level statements
+// that are parsed in parallel. --dialect picks the keywords the files are
+// written with; the sample programs are always English.
+int main(int argc, char *argv[])
 {
+    size_t lexThreads = 1;
+    size_t parseThreads = 1;
+    bool urdu = false;
+    unique_ptr<TokenCache> cache;
+    vector<MappedFile> files;
+    vector<string_view> sources;
+    vector<string> names;
+    files.reserve(argc);
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.rfind("--lex-threads=", 0) == 0)
+        {
+            lexThreads = max(1, atoi(arg.c_str() + 14));
+            continue;
+        }
+        if (arg.rfind("--parse-threads=", 0) == 0)
+        {
+            parseThreads = max(1, atoi(arg.c_str() + 16));
+            continue;
+        }
+        if (arg.rfind("--dialect=", 0) == 0)
+        {
+            string dialect = arg.substr(10);
+            if (dialect != EnglishDialect::NAME && dialect != UrduDialect::NAME)
+            {
+                cerr << "Error: unknown dialect '" << dialect << "'\n";
+                return 1;
+            }
+            urdu = dialect == UrduDialect::NAME;
+            continue;
+        }
+        if (arg.rfind("--token-cache=", 0) == 0)
+        {
+            cache = make_unique<TokenCache>(arg.substr(14));
+            continue;
+        }
+        files.emplace_back(arg);
+        if (!files.back().isOpen())
+        {
+            cerr << "Error: cannot open source file '" << arg << "'\n";
+            return 1;
+        }
+        sources.push_back(files.back().view());
+        names.push_back(arg);
+    }
+    if (!sources.empty())
+    {
+        if (urdu)
+        {
+            return compileSources<UrduDialect>(sources, names, lexThreads, cache.get(), parseThreads);
+        }
+        return compileSources(sources, names, lexThreads, cache.get(), parseThreads);
+    }
+
     string input2 = R"(
         int x = 10;
         int a;
@@ -1062,32 +4513,6 @@ int main()
         return y + 1;
     )";
 
-    Lexer lexer1(input);
-    Lexer lexer2(input2);
-
-    vector<Token> tokens1 = lexer1.tokenize();
-    vector<Token> tokens2 = lexer2.tokenize();
-
-    TACGenerator tacGen1, tacGen2;
-    Parser parser1(tokens1, tacGen1);
-    Parser parser2(tokens2, tacGen2);
-
-    pthread_t lexerTid1, lexerTid2, parserTid1, parserTid2;
-
-    pthread_create(&lexerTid1, NULL, lexerThread, &lexer1);
-    pthread_create(&lexerTid2, NULL, lexerThread, &lexer2);
-
-    // Wait for lexer threads to finish
-    pthread_join(lexerTid1, NULL);
-    pthread_join(lexerTid2, NULL);
-
-    // Create parser threads for both tokenized inputs
-    pthread_create(&parserTid1, NULL, parserThread, &parser1);
-    pthread_create(&parserTid2, NULL, parserThread, &parser2);
-
-    // Wait for parser threads to finish
-    pthread_join(parserTid1, NULL);
-    pthread_join(parserTid2, NULL);
-
-    return 0;
+    return compileSources({input, input2}, {"sample program 1", "sample program 2"}, lexThreads, cache.get());
 }
+#endif